@@ -0,0 +1,10 @@
+# benchmarks the gen~ exports (.cpp) in a folder, by default ../examples (exported by opening the example patchers in Max)
+# e.g. ./bench.sh path/to/exports 48kHz block48
+dir="${1:-../examples}"
+[ $# -gt 0 ] && shift
+if ! ls "$dir"/*.cpp > /dev/null 2>&1; then
+	echo "bench.sh: no gen~ exports (.cpp) in $dir; export some from gen~ first, or give the folder they are in, e.g. ./bench.sh path/to/exports"
+	exit 1
+fi
+rm -rf build_* && \
+node oopsy.js host "$dir" "$@"
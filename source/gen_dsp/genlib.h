@@ -211,18 +211,26 @@ extern "C" {
 #endif // MSP_ON_CLANG
 
 
-// #if defined(GENLIB_USE_ARMMATH) // ARM embedded support
-// #	include "arm_math.h"
-// #	define sin(x)		arm_sin_f32(x)
-// #	define sinf(x)		arm_sin_f32(x)
-// #	define cos(x)		arm_cos_f32(x)
-// #	define cosf(x)		arm_cos_f32(x)
-// #	define sqrt(x)		arm_sqrtf(x)
-// #	define sqrtf(x)		arm_sqrtf(x)
-// #	define rand(...)	arm_rand32()
-// #	undef RAND_MAX
-// #	define RAND_MAX		UINT32_MAX
-// #endif // GENLIB_USE_ARMMATH
+#if defined(GENLIB_USE_ARMMATH) // ARM embedded support
+#	include <math.h>
+#	include <cmath>
+#	include "arm_math.h"
+	// overloads rather than macros, which would also rewrite std::sin etc. in every header after this one;
+	// exported code sees them through GENLIB_ARMMATH_USING in its own namespace, where they hide the <cmath> ones
+	namespace genlib_armmath {
+		inline float sin(float x) { return arm_sin_f32(x); }
+		inline float sinf(float x) { return arm_sin_f32(x); }
+		inline float cos(float x) { return arm_cos_f32(x); }
+		inline float cosf(float x) { return arm_cos_f32(x); }
+		// arm_sqrt_f32 returns a status and writes the root through a pointer:
+		inline float sqrt(float x) { float y; arm_sqrt_f32(x, &y); return y; }
+		inline float sqrtf(float x) { return sqrt(x); }
+	}
+#	define GENLIB_ARMMATH_USING \
+		using genlib_armmath::sin; using genlib_armmath::sinf; \
+		using genlib_armmath::cos; using genlib_armmath::cosf; \
+		using genlib_armmath::sqrt; using genlib_armmath::sqrtf;
+#endif // GENLIB_USE_ARMMATH
 
 #if defined(GENLIB_USE_FASTMATH)
 #	include <math.h>
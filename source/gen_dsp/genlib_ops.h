@@ -42,9 +42,10 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #endif
 
 // denormal numbers cannot occur when hosted in MSP, nor on ARM Cortex processors:
-#if defined(MSP_ON_CLANG) || defined(ARM_MATH_CM4) || defined(ARM_MATH_CM7)
+#if (defined(MSP_ON_CLANG) || defined(ARM_MATH_CM4) || defined(ARM_MATH_CM7)) && !defined(GENLIB_NO_DENORM_TEST)
 #	define GENLIB_NO_DENORM_TEST 1
 #endif // defined(MSP_ON_CLANG) || defined(ARM_MATH_CM4) || defined(ARM_MATH_CM7)
+// GENLIB_NO_NAN_TEST makes fixnan() a no-op, for code that can't produce NaNs (genlib_isnan() still tests)
 
 #ifdef GENLIB_USE_FLOAT32
 #	define GENLIB_EPSILON GENLIB_FLT_EPSILON
@@ -60,10 +61,14 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 // assumes v is a 64-bit double:
 #ifdef GENLIB_USE_FLOAT32
 #	define GENLIB_IS_NAN_FLOAT(v)			((v)!=(v))
-#	define GENLIB_FIX_NAN_FLOAT(v)			((v)=GENLIB_IS_NAN_FLOAT(v)?0.f:(v))
+#	ifdef GENLIB_NO_NAN_TEST
+#		define GENLIB_FIX_NAN_FLOAT(v)		(v)
+#	else
+#		define GENLIB_FIX_NAN_FLOAT(v)		((v)=GENLIB_IS_NAN_FLOAT(v)?0.f:(v))
+#	endif
 
 #	ifdef GENLIB_NO_DENORM_TEST
-#		define GENLIB_IS_DENORM_FLOAT(v)	(v)
+#		define GENLIB_IS_DENORM_FLOAT(v)	(0)
 #		define GENLIB_FIX_DENORM_FLOAT(v)	(v)
 #	else
 #		ifdef WIN32
@@ -79,10 +84,14 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #	define GENLIB_FIX_DENORM	GENLIB_FIX_DENORM_FLOAT
 #else // GENLIB_USE_FLOAT32
 #	define GENLIB_IS_NAN_DOUBLE(v)			(((((uint32_t *)&(v))[1])&0x7fe00000)==0x7fe00000)
-#	define GENLIB_FIX_NAN_DOUBLE(v)		((v)=GENLIB_IS_NAN_DOUBLE(v)?0.:(v))
+#	ifdef GENLIB_NO_NAN_TEST
+#		define GENLIB_FIX_NAN_DOUBLE(v)		(v)
+#	else
+#		define GENLIB_FIX_NAN_DOUBLE(v)		((v)=GENLIB_IS_NAN_DOUBLE(v)?0.:(v))
+#	endif
 
 #	ifdef GENLIB_NO_DENORM_TEST
-#		define GENLIB_IS_DENORM_DOUBLE(v)	(v)
+#		define GENLIB_IS_DENORM_DOUBLE(v)	(0)
 #		define GENLIB_FIX_DENORM_DOUBLE(v)	(v)
 #	else // GENLIB_NO_DENORM_TEST
 #		define GENLIB_IS_DENORM_DOUBLE(v)	((((((uint32_t *)&(v))[1])&0x7fe00000)==0)&&((v)!=0.))
@@ -150,7 +159,8 @@ inline t_sample safepow(t_sample base, t_sample exponent) {
 
 inline t_sample absdiff(t_sample a, t_sample b) { return fabs(a-b); }
 
-#if !defined (__arm__) && !defined(WIN32)
+// (C++11 <cmath> already has these:)
+#if !defined (__arm__) && !defined(WIN32) && (__cplusplus < 201103L)
 inline t_sample exp2(t_sample v) { return pow(2., v); }
 
 inline t_sample trunc(t_sample v) {
@@ -660,6 +670,17 @@ struct Delta {
 		history = in1;
 		return ret;
 	}
+
+	// n samples at once (out may be in)
+	inline void process(t_sample *out, const t_sample *in, long n) {
+		t_sample h = history;
+		for (long i=0; i<n; i++) {
+			const t_sample x = in[i];
+			out[i] = x - h;
+			h = x;
+		}
+		history = h;
+	}
 };
 struct Change {
 	t_sample history;
@@ -798,6 +819,21 @@ struct DCBlock {
 		y1 = y;
 		return y;
 	}
+
+	// n samples at once (out may be in)
+	inline void process(t_sample *out, const t_sample *in, long n) {
+		t_sample x = x1, y = y1;
+		for (long i=0; i<n; i++) {
+			// the difference doesn't depend on the feedback, so it can issue alongside the previous multiply:
+			const t_sample in1 = in[i];
+			const t_sample d = in1 - x;
+			y = d + y*t_sample(0.9997);
+			x = in1;
+			out[i] = y;
+		}
+		x1 = x;
+		y1 = y;
+	}
 };
 
 #ifdef GENLIB_USE_FLOAT32
@@ -843,6 +879,24 @@ struct Noise {
 		static const t_sample EXP2_NEG23 = exp2f(-23.f);
 		return ((result >> 8)*EXP2_NEG23) - 1.f; 
 	}
+
+	// n samples at once, with the state kept in registers
+	inline void process(t_sample *out, long n) {
+		static const t_sample EXP2_NEG23 = exp2f(-23.f);
+		uint32_t s0 = state[0], s1 = state[1], s2 = state[2], s3 = state[3];
+		for (long i=0; i<n; i++) {
+			const uint32_t result = s0 + s3;
+			const uint32_t t = s1 << 9;
+			s2 ^= s0;
+			s3 ^= s1;
+			s1 ^= s2;
+			s0 ^= s3;
+			s2 ^= t;
+			s3 = (s3 << 11) | (s3 >> 21);
+			out[i] = ((result >> 8)*EXP2_NEG23) - 1.f;
+		}
+		state[0] = s0; state[1] = s1; state[2] = s2; state[3] = s3;
+	}
 	
     // splitmix32 suggested by David Blackman and Sebastiano Vigna as a good seed for xoshiro256+:
 	/* This is a fixed-increment version of Java 8's SplittableRandom generator
@@ -899,6 +953,11 @@ struct Noise {
 		static const t_sample EXP2_NEG52 = exp2(-52);
 		return ((result >> 11)*EXP2_NEG52) - 1.0; 
 	}
+
+	// n samples at once
+	inline void process(t_sample *out, long n) {
+		for (long i=0; i<n; i++) out[i] = (*this)();
+	}
 	
     // splitmix64 suggested by David Blackman and Sebastiano Vigna as a good seed for xoshiro256+:
 	/* This is a fixed-increment version of Java 8's SplittableRandom generator
@@ -925,6 +984,33 @@ struct Phasor {
 		phase = wrap(phase + pincr, 0., 1.);
 		return phase;
 	}
+
+	// n samples at once, with a frequency per sample
+	inline void process(t_sample *out, const t_sample *freq, t_sample invsamplerate, long n) {
+		t_sample p = phase;
+		for (long i=0; i<n; i++) {
+			p = wrap(p + freq[i] * invsamplerate, 0., 1.);
+			out[i] = p;
+		}
+		phase = p;
+	}
+
+	// n samples at once at a constant frequency
+	inline void process(t_sample *out, t_sample freq, t_sample invsamplerate, long n) {
+		const t_sample pincr = freq * invsamplerate;
+		// positive increments under one cycle only ever wrap once:
+		if (pincr < t_sample(0.) || pincr >= t_sample(1.) || phase < t_sample(0.) || phase >= t_sample(1.)) {
+			for (long i=0; i<n; i++) out[i] = (*this)(freq, invsamplerate);
+			return;
+		}
+		t_sample p = phase;
+		for (long i=0; i<n; i++) {
+			p += pincr;
+			if (p >= t_sample(1.)) p -= t_sample(1.);
+			out[i] = p;
+		}
+		phase = p;
+	}
 };
 
 struct PlusEquals {
@@ -993,6 +1079,19 @@ struct Sah {
 		prev = trig;
 		return output;
 	}
+
+	// n samples at once (out may be in)
+	inline void process(t_sample *out, const t_sample *in, const t_sample *trig, t_sample thresh, long n) {
+		t_sample p = prev, o = output;
+		for (long i=0; i<n; i++) {
+			const t_sample t = trig[i];
+			if (p <= thresh && t > thresh) o = in[i];
+			p = t;
+			out[i] = o;
+		}
+		prev = p;
+		output = o;
+	}
 };
 
 struct Train {
@@ -1207,9 +1306,66 @@ struct Delay {
 		t_sample y5 = memory[r5 & wrap];
 		return spline6_interp(a, y0, y1, y2, y3, y4, y5);
 	}
+
+	// block API: read a whole block from the taps, then write_block() in place of write() & step()
+	// delays shorter than the block would read samples not written yet, so are clamped to n
+
+	// a fixed tap, as n calls of read_step(d), copied in contiguous segments
+	// (two at most, unless the delay is shorter than the block)
+	inline void read_block(t_sample *out, t_sample d, long n) const {
+		long first = long(t_sample(size + reader) - clamp(d-t_sample(0.5), t_sample(n), t_sample(maxdelay))) & wrap;
+		for (long i=0; i<n; first=0) {
+			long len = (size - first < n - i) ? size - first : n - i;
+			memcpy(out + i, memory + first, sizeof(t_sample) * len);
+			i += len;
+		}
+	}
+
+	// a modulated tap, as n calls of read_linear(d[i])
+	inline void read_linear_block(t_sample *out, const t_sample *d, long n) const {
+		const t_sample lo = t_sample(n), hi = t_sample(maxdelay);
+		t_sample base = t_sample(size + reader);
+		for (long i=0; i<n; i++, base += t_sample(1.)) {
+			const t_sample r = base - clamp(d[i], lo, hi);
+			long r1 = long(r);
+			t_sample a = r - (t_sample)r1;
+			out[i] = linear_interp(a, memory[r1 & wrap], memory[(r1+1) & wrap]);
+		}
+	}
+
+	// n calls of write(in[i]) & step()
+	inline void write_block(const t_sample *in, long n) {
+		for (long i=0, w=reader; i<n; w=0) {
+			long len = (size - w < n - i) ? size - w : n - i;
+			memcpy(memory + w, in + i, sizeof(t_sample) * len);
+			i += len;
+		}
+		writer = (reader + n - 1) & wrap;
+		reader = (reader + n) & wrap;
+	}
 };
 
-template<typename T=t_sample>
+// conversion between the values a DataInterface stores and the samples it reads & writes
+// (specialized for compact storage types)
+template<typename T>
+struct DataSample {
+	static inline t_sample load(T v) { return t_sample(v); }
+	static inline T store(t_sample v) { return T(v); }
+};
+
+template<>
+struct DataSample<int16_t> {
+	static inline t_sample load(int16_t v) { return t_sample(v) * t_sample(0.000030517578125); }
+	static inline int16_t store(t_sample v) {
+		// offset to positive so truncation rounds to nearest, without a branch on the sign:
+		v = clamp(v * t_sample(32768.), t_sample(-32768.), t_sample(32767.));
+		return int16_t(int32_t(v + t_sample(32768.5)) - 32768);
+	}
+};
+
+// PLANAR data stores each channel's frames contiguously (all of channel 0, then all of channel 1...),
+// rather than interleaving the channels of each frame
+template<typename T=t_sample, bool PLANAR=false>
 struct DataInterface {
 	long dim, channels;
 	T *mData;
@@ -1218,37 +1374,43 @@ struct DataInterface {
 
 	DataInterface() : dim(0), channels(1), mData(0), modified(0) { mDataReference = 0; }
 
+	// where a sample lives in mData
+	inline long offset(long index, long channel) const {
+		return PLANAR ? index+channel*dim : channel+index*channels;
+	}
+
 	// raw reading/writing/overdubbing (internal use only, no bounds checking)
 	inline t_sample read(long index, long channel=0) const {
-		return mData[channel+index*channels];
+		return DataSample<T>::load(mData[offset(index, channel)]);
 	}
-	inline void write(T value, long index, long channel=0) {
-		mData[channel+index*channels] = value;
+	inline void write(t_sample value, long index, long channel=0) {
+		mData[offset(index, channel)] = DataSample<T>::store(value);
 		modified = 1;
 	}
 	// NO LONGER USED:
-	inline void overdub(T value, long index, long channel=0) {
-		mData[channel+index*channels] += value;
+	inline void overdub(t_sample value, long index, long channel=0) {
+		long o = offset(index, channel);
+		mData[o] = DataSample<T>::store(DataSample<T>::load(mData[o]) + value);
 		modified = 1;
 	}
 
 	// averaging overdub (used by splat)
-	inline void blend(T value, long index, long channel, t_sample alpha) {
-		long offset = channel+index*channels;
-		const T old = mData[offset];
-		mData[offset] = old + alpha * (value - old);
+	inline void blend(t_sample value, long index, long channel, t_sample alpha) {
+		long o = offset(index, channel);
+		const t_sample old = DataSample<T>::load(mData[o]);
+		mData[o] = DataSample<T>::store(old + alpha * (value - old));
 		modified = 1;
 	}
 
 	// NO LONGER USED:
 	inline void read_ok(long index, long channel=0, bool ok=1) const {
-		return ok ? mData[channel+index*channels] : T(0);
+		return ok ? mData[offset(index, channel)] : T(0);
 	}
 	inline void write_ok(T value, long index, long channel=0, bool ok=1) {
-		if (ok) mData[channel+index*channels] = value;
+		if (ok) mData[offset(index, channel)] = value;
 	}
 	inline void overdub_ok(T value, long index, long channel=0, bool ok=1) {
-		if (ok) mData[channel+index*channels] += value;
+		if (ok) mData[offset(index, channel)] += value;
 	}
 
 	// Bounds strategies:
@@ -1277,7 +1439,7 @@ struct DataInterface {
 	// [-1..1] -> [0..(dim-1)]
 	inline t_sample signal2index(t_sample signal) const { return phase2index((signal+t_sample(1.)) * t_sample(0.5)); }
 
-	inline T peek(t_sample index, long channel=0) const {
+	inline t_sample peek(t_sample index, long channel=0) const {
 		const long i = (long)index;
 		if (index_oob(i) || channel_oob(channel)) {
 			return 0.;
@@ -1286,7 +1448,7 @@ struct DataInterface {
 		}
 	}
 
-	inline T index(t_sample index, long channel=0) const {
+	inline t_sample index(t_sample index, long channel=0) const {
 		channel = channel_clamp(channel);
 		// no-interp:
 		long i = (long)index;
@@ -1295,7 +1457,7 @@ struct DataInterface {
 		return read(i, channel);
 	}
 
-	inline T cell(t_sample index, long channel=0) const {
+	inline t_sample cell(t_sample index, long channel=0) const {
 		channel = channel_clamp(channel);
 		// no-interp:
 		long i = (long)index;
@@ -1304,7 +1466,7 @@ struct DataInterface {
 		return read(i, channel);
 	}
 
-	inline T cycle(t_sample phase, long channel=0) const {
+	inline t_sample cycle(t_sample phase, long channel=0) const {
 		channel = channel_clamp(channel);
 		t_sample index = phase2index(phase);
 		// interp:
@@ -1315,12 +1477,12 @@ struct DataInterface {
 		i1 = index_wrap(i1);
 		i2 = index_wrap(i2);
 		// interp:
-		T v1 = read(i1, channel);
-		T v2 = read(i2, channel);
+		t_sample v1 = read(i1, channel);
+		t_sample v2 = read(i2, channel);
 		return mix(v1, v2, alpha);
 	}
 
-	inline T lookup(t_sample signal, long channel=0) const {
+	inline t_sample lookup(t_sample signal, long channel=0) const {
 		channel = channel_clamp(channel);
 		t_sample index = signal2index(signal);
 		// interp:
@@ -1331,8 +1493,8 @@ struct DataInterface {
 		i1 = index_clamp(i1);
 		i2 = index_clamp(i2);
 		// interp:
-		T v1 = read(i1, channel);
-		T v2 = read(i2, channel);
+		t_sample v1 = read(i1, channel);
+		t_sample v2 = read(i2, channel);
 		return mix(v1, v2, alpha);
 	}
 	// NO LONGER USED:
@@ -1371,8 +1533,8 @@ struct DataInterface {
 		i1 = index_wrap(i1);
 		i2 = index_wrap(i2);
 		// interp:
-		const T v1 = read(i1, channel);
-		const T v2 = read(i2, channel);
+		const t_sample v1 = read(i1, channel);
+		const t_sample v2 = read(i2, channel);
 		write(v1 + (1.-alpha)*(valuef-v1), i1, channel);
 		write(v2 + (alpha)*(valuef-v2), i2, channel);
 	}
@@ -1448,7 +1610,7 @@ struct DataLocal : public DataInterface<t_sample> {
 			genlib_report_message("warning: resizing data to < 256MB");
 		}
 		if (mData) {
-			genlib_sysmem_resizeptr(mData, sizeof(t_sample) * s * c);
+			mData = (t_sample *)genlib_sysmem_resizeptr(mData, sizeof(t_sample) * s * c);
 		} else {
 			mData = (t_sample *)genlib_sysmem_newptr(sizeof(t_sample) * s * c);
 		}
@@ -1571,18 +1733,33 @@ struct Buffer : public DataInterface<float> {
 	}
 };
 
+#define GENLIB_SINE_TABLE_SIZE (1 << 14)	// 14 bit index (noise floor at around -156 dB)
+
+#ifdef GENLIB_SHARED_SINE_TABLE
+// one read-only cosine table, generated at build time, shared by every SineData:
+extern const t_sample genlib_sine_table[GENLIB_SINE_TABLE_SIZE];
+#endif
+
 struct SineData : public DataLocal {
 	SineData() : DataLocal() {
-		const int costable_size = 1 << 14;	// 14 bit index (noise floor at around -156 dB)
+		#ifdef GENLIB_SHARED_SINE_TABLE
+		// SineCycle only ever reads the table, so it can stay in flash:
+		mData = const_cast<t_sample *>(genlib_sine_table);
+		dim = GENLIB_SINE_TABLE_SIZE;
+		channels = 1;
+		#else
 		mData = 0;
-		resize(costable_size, 1);
+		resize(GENLIB_SINE_TABLE_SIZE, 1);
 		for (int i=0; i<dim; i++) {
 			mData[i] = t_sample(cos(i * GENLIB_PI * 2. / (t_sample)(dim)));
 		}
+		#endif
 	}
 
 	~SineData() {
+		#ifndef GENLIB_SHARED_SINE_TABLE
 		if (mData) genlib_sysmem_freeptr(mData);
+		#endif
 		mData = 0;
 	}
 };
@@ -1617,8 +1794,8 @@ struct SineCycle {
 		return t_sample(phasei * t_sample(0.232830643653869629e-9));
 	}
 
-	template<typename T>
-	inline t_sample operator()(const DataInterface<T>& buf) {
+	template<typename T, bool PLANAR>
+	inline t_sample operator()(const DataInterface<T, PLANAR>& buf) {
 		T *data = buf.mData;
 		// divide uint32_t range down to buffer size (32-bit to 14-bit)
 		uint32_t idx = phasei >> 18;
@@ -1631,6 +1808,50 @@ struct SineCycle {
 		phasei += pincr;
 		return y;
 	}
+
+	// one sample of the table at phase p
+	template<typename T>
+	static inline t_sample lookup(const T *data, uint32_t p) {
+		const uint32_t idx = p >> 18;
+		const t_sample frac = t_sample(p & 262143) * t_sample(3.81471181759574e-6);
+		return linear_interp(frac, t_sample(data[idx]), t_sample(data[(idx+1) & 16383]));
+	}
+
+	// n samples at once, with a frequency per sample (as freq() then operator() for each)
+	template<typename T, bool PLANAR>
+	inline void process(t_sample *out, const DataInterface<T, PLANAR>& buf, const t_sample *freq, long n) {
+		const T *data = buf.mData;
+		uint32_t p = phasei;
+		uint32_t inc = pincr;
+		for (long i=0; i<n; i++) {
+			inc = uint32_t(freq[i] * f2i);
+			out[i] = lookup(data, p);
+			p += inc;
+		}
+		phasei = p;
+		pincr = inc;
+	}
+
+	// n samples at the current frequency
+	// two phases are stepped at once, so that their lookups can be interleaved
+	template<typename T, bool PLANAR>
+	inline void process(t_sample *out, const DataInterface<T, PLANAR>& buf, long n) {
+		const T *data = buf.mData;
+		uint32_t p0 = phasei, p1 = phasei + pincr;
+		const uint32_t inc2 = pincr * 2;
+		long i = 0;
+		for (; i+1<n; i+=2) {
+			out[i] = lookup(data, p0);
+			out[i+1] = lookup(data, p1);
+			p0 += inc2;
+			p1 += inc2;
+		}
+		if (i < n) {
+			out[i] = lookup(data, p0);
+			p0 += pincr;
+		}
+		phasei = p0;
+	}
 };
 
 #endif
@@ -36,19 +36,21 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 // DATA_MAXIMUM_ELEMENTS * 8 bytes = 256 mb limit
 #define DATA_MAXIMUM_ELEMENTS	(33554432)
 
-t_ptr genlib_sysmem_resizeptr(void *ptr, t_ptr_size newsize) {
-	// this function only seems to get called by SineData if reset() happens a second time
-	// this shouldn't ever happen, so we default to new allocation:
-	return genlib_sysmem_newptr(newsize);
-}
+// defined in genlib_daisy.h:
+t_ptr genlib_data_newptr(void *ref, long dim, long channels, long samplesize, int * preloaded);
 
-void genlib_sysmem_freeptr(void *ptr) {
-	// nothing to do, we are not running memory management here
+t_ptr genlib_sysmem_resizeptr(void *ptr, t_ptr_size newsize) {
+	// in place if the arena allows, otherwise moved to a new block:
+	return (t_ptr)oopsy::reallocate(ptr, newsize);
 }
 
 void genlib_set_zero64(t_sample *memory, long size) {
+#ifdef GENLIB_USE_ARMMATH
+	arm_fill_f32(0.f, memory, size);
+#else
 	long i;
 	for (i = 0; i < size; i++, memory++) *memory = 0.;
+#endif
 }
 
 // NEED THIS FOR WINDOWS:
@@ -57,8 +59,9 @@ void *operator new[](size_t size) { return genlib_sysmem_newptr(size); }
 void operator delete(void *p) throw() { genlib_sysmem_freeptr(p); }
 void operator delete[](void *p) throw() { genlib_sysmem_freeptr(p); }
 
+// the reference is just the name, which is a string literal in the exported code:
 void *genlib_obtain_reference_from_string(const char *name) {
-	return 0; // to be implemented
+	return (void *)name;
 }
 
 // the rest is stuff to isolate gensym, attrs, atoms, buffers etc.
@@ -79,7 +82,7 @@ t_genlib_err genlib_buffer_getinfo(t_genlib_buffer *b, t_genlib_buffer_info *inf
 }
 
 char *genlib_reference_getname(void *ref) {
-	return 0; // to be implemented
+	return (char *)ref;
 }
 
 void genlib_buffer_dirty(t_genlib_buffer *b) {
@@ -104,7 +107,7 @@ void genlib_data_setbuffer(t_genlib_data *b, void *ref) {
 typedef struct {
 	t_genlib_data_info	info;
 	t_sample			cursor;	// used by Delay
-	//t_symbol *		name;
+	void *				ref;	// the name of the [data] or [delay]
 } t_dsp_gen_data;
 
 t_genlib_data *genlib_obtain_data_from_reference(void *ref) {
@@ -113,6 +116,7 @@ t_genlib_data *genlib_obtain_data_from_reference(void *ref) {
 	self->info.channels = 0;
 	self->info.data = 0;
 	self->cursor = 0;
+	self->ref = ref;
 	return (t_genlib_data *)self;
 }
 
@@ -178,12 +182,24 @@ void genlib_data_resize(t_genlib_data *b, long s, long c) {
 		}
 
 		genlib_set_zero64(self->info.data, s * c);
+		// a cached sample that was cleared no longer matches its file:
+		oopsy::sample_cache.invalidate(self->info.data);
+		return;
+
+	} else if (old && c == oldchannels && oopsy::resize(old, sz)) {
+		// grown or shrunk where it is; since the data is interleaved, the frames it keeps don't move
+		// (so, like a clear, the audio thread only ever sees a length that fits the memory)
+		if (s > olddim) {
+			genlib_set_zero64(old + olddim * c, (s - olddim) * c);
+		}
+		self->info.dim = s;
 		return;
 
 	} else {
 
-		// allocate new:
-		replaced = (t_sample *)genlib_sysmem_newptr(sz);
+		// allocate new, in the memory region planned for this [data] or [delay]:
+		int preloaded = 0;
+		replaced = (t_sample *)genlib_data_newptr(self->ref, s, c, sizeof(t_sample), &preloaded);
 
 		// check allocation:
 		if (replaced == 0) {
@@ -198,11 +214,11 @@ void genlib_data_resize(t_genlib_data *b, long s, long c) {
 			return;
 		}
 
-		// fill with zeroes:
-		genlib_set_zero64(replaced, s * c);
+		// fill with zeroes, unless it already holds a sample from the cache:
+		if (!preloaded) genlib_set_zero64(replaced, s * c);
 
 		// copy in old data:
-		if (old) {
+		if (old && !preloaded) {
 			// frames to copy:
 			// clamped:
 			copydim = olddim > s ? s : olddim;
@@ -258,8 +274,8 @@ void genlib_data_resize(t_genlib_data *b, long s, long c) {
 				}
 			}
 
-			// done with old:
-			genlib_sysmem_freeptr(old);
+			// done with old, once the audio thread can no longer be reading it:
+			oopsy::daisy.retire(old);
 
 		}
 	}
@@ -267,15 +283,37 @@ void genlib_data_resize(t_genlib_data *b, long s, long c) {
 
 void genlib_reset_complete(void *data) {}
 
+// the state is the value of each float param, in param order; symbol params (e.g. [data] references) aren't included
 size_t genlib_getstatesize(CommonState *cself, getparameter_method getmethod) {
-	return 0;
+	size_t size = 0;
+	for (int i = 0; i < cself->numparams; i++) {
+		if (cself->params[i].paramtype == GENLIB_PARAMTYPE_FLOAT) size += sizeof(t_param);
+	}
+	return size;
 }
 
 short genlib_getstate(CommonState *cself, char *state, getparameter_method getmethod) {
+	for (int i = 0; i < cself->numparams; i++) {
+		if (cself->params[i].paramtype == GENLIB_PARAMTYPE_FLOAT) {
+			t_param value = 0;
+			getmethod(cself, i, &value);
+			// (the state buffer needn't be aligned)
+			memcpy(state, &value, sizeof(t_param));
+			state += sizeof(t_param);
+		}
+	}
 	return 0;
 }
 
 short genlib_setstate(CommonState *cself, const char *state, setparameter_method setmethod) {
+	for (int i = 0; i < cself->numparams; i++) {
+		if (cself->params[i].paramtype == GENLIB_PARAMTYPE_FLOAT) {
+			t_param value;
+			memcpy(&value, state, sizeof(t_param));
+			state += sizeof(t_param);
+			setmethod(cself, i, value, 0);
+		}
+	}
 	return 0;
 }
 
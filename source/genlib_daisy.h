@@ -20,7 +20,6 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include <math.h>
 #include <string>
 #include <cstring> // memset
-#include <stdarg.h> // vprintf
 
 // #if defined(OOPSY_TARGET_SEED)
 // 	typedef struct {
@@ -41,49 +40,758 @@ static bool      update = false;
 
 ////////////////////////// DAISY EXPORT INTERFACING //////////////////////////
 
+// MIDI output queues (powers of two): messages, and realtime bytes which jump ahead of them
 #define OOPSY_MIDI_BUFFER_SIZE (1024)
+#define OOPSY_MIDI_REALTIME_SIZE (64)
+// continuous MIDI outputs (CC, pressure, bend) that only send their latest value:
+#ifndef OOPSY_MIDI_OUT_SLOTS
+#define OOPSY_MIDI_OUT_SLOTS (32)
+#endif
+// MIDI input bytes waiting for the next audio block (and for the main loop):
+#define OOPSY_MIDI_IN_QUEUE_SIZE (256)
+// the UART's circular DMA receive buffer:
+#define OOPSY_MIDI_RX_BUFFER_SIZE (256)
+// bytes sent per DMA transmit: one message at most, so that realtime bytes wait no longer than that
+#define OOPSY_MIDI_TX_BATCH (3)
 #define OOPSY_LONG_PRESS_MS (333)
 #define OOPSY_SUPER_LONG_PRESS_MS (20000)
 #define OOPSY_DISPLAY_PERIOD_MS 10
-#define OOPSY_SCOPE_MAX_ZOOM (8)
+// FNV-1a, for the retained display rows:
+#define OOPSY_DISPLAY_HASH (2166136261u)
+// the control task scans the hardware this often, in microseconds:
+#ifdef OOPSY_CONTROL_TASK
+#define OOPSY_CONTROL_PERIOD_US (1000000 / OOPSY_CONTROL_RATE)
+#endif
+// with OOPSY_CROSSFADE_BLOCKS, app switches prepare the next app while the current one plays, then crossfade over this many blocks
+#ifdef OOPSY_CROSSFADE_BLOCKS
+#define OOPSY_APP_SLOTS (2)
+#else
+#define OOPSY_APP_SLOTS (1)
+#endif
+// with OOPSY_VOICES, a gen~ voice kernel is instantiated this many times, and MIDI notes are allocated to the copies
+#ifdef OOPSY_VOICES
+// a released voice whose peak level stays below this for this many frames stops being performed
+// (long enough that a low note's waveform can't look silent for a block):
+#ifndef OOPSY_VOICE_SILENCE
+#define OOPSY_VOICE_SILENCE (0.0001f)
+#endif
+#ifndef OOPSY_VOICE_SILENT_FRAMES
+#define OOPSY_VOICE_SILENT_FRAMES (1024)
+#endif
+// which voice a new note takes once every voice is sounding (released voices are always taken first):
+#define OOPSY_VOICE_STEAL_OLDEST (0)
+#define OOPSY_VOICE_STEAL_QUIETEST (1)
+#define OOPSY_VOICE_STEAL_NONE (2)
+#ifndef OOPSY_VOICE_STEAL
+#define OOPSY_VOICE_STEAL (OOPSY_VOICE_STEAL_OLDEST)
+#endif
+#endif
+// with OOPSY_IDLE_HOLD_MS, an app whose inputs and outputs have stayed below this peak level for that long
+// stops being performed (its outputs are silent) until an input, MIDI or a param change wakes it:
+#ifdef OOPSY_IDLE_HOLD_MS
+#ifndef OOPSY_IDLE_SILENCE
+#define OOPSY_IDLE_SILENCE (0.0001f)
+#endif
+#endif
+// log messages are queued in a ring of this many entries (a power of two) by any context, and formatted in the main loop;
+// each has room for this many bytes of arguments, including copies of any strings:
+#if defined(OOPSY_TARGET_HAS_OLED) || defined(OOPSY_LOG_SERIAL)
+#define OOPSY_HAS_LOG (1)
+#endif
+#define OOPSY_LOG_RING_SIZE (32)
+#define OOPSY_LOG_ARG_BYTES (40)
+#define OOPSY_LOG_LINE (96)
+#define OOPSY_SCOPE_MAX_ZOOM (11)
+// the audio callback copies the scope's source channels into a ring of this many frames (a power of two), in SDRAM;
+// it must hold the display width at the largest zoom, with room for the blocks written while the main loop reads
+#define OOPSY_SCOPE_RING_FRAMES (32768)
+// seconds of audio the on-target bench runs at each block size:
+#ifndef OOPSY_BENCH_SECONDS
+#define OOPSY_BENCH_SECONDS (2)
+#endif
+static const uint32_t OOPSY_DTCM_SIZE = 32 * 1024;
 static const uint32_t OOPSY_SRAM_SIZE = 512 * 1024; 
 static const uint32_t OOPSY_SDRAM_SIZE = 64 * 1024 * 1024;
+// all arena blocks start on a cache line:
+#define OOPSY_ALLOC_ALIGN (32)
+// blocks replaced by a [data] resize that each arena holds until the audio callback has moved on:
+#define OOPSY_ARENA_RETIRED (8)
+// SDRAM reserved for wav files shared between apps:
+#ifndef OOPSY_SAMPLE_CACHE_BYTES
+#ifdef OOPSY_MULTI_APP
+#define OOPSY_SAMPLE_CACHE_BYTES (16 * 1024 * 1024)
+#else
+#define OOPSY_SAMPLE_CACHE_BYTES (0)
+#endif
+#endif
+#define OOPSY_SAMPLE_CACHE_ENTRIES (32)
+// with OOPSY_USE_SNAPSHOTS, the end of the QSPI flash holds a snapshot of each app's params and [data foo_snapshot] tables,
+// split evenly between the apps in whole sectors:
+#ifdef OOPSY_USE_SNAPSHOTS
+#define OOPSY_QSPI_SIZE (8 * 1024 * 1024)
+#ifndef OOPSY_SNAPSHOT_BYTES
+#define OOPSY_SNAPSHOT_BYTES (1024 * 1024)
+#endif
+#define OOPSY_SNAPSHOT_SECTOR (4096)
+#define OOPSY_SNAPSHOT_MAGIC (0x4F50534Eu)
+#define OOPSY_SNAPSHOT_TABLES (8)
+// params (4 bytes each) that fit in a snapshot:
+#define OOPSY_SNAPSHOT_STATE_BYTES (1024)
+#endif
 
 // Added dedicated global SDFile to replace old global from libDaisy
 FIL SDFile;
 
 namespace oopsy {
 
-	uint32_t sram_used = 0, sram_usable = 0;
-	uint32_t sdram_used = 0, sdram_usable = 0;
+	// memory regions, ordered from fastest to slowest
+	// an allocation that doesn't fit in its preferred region falls through to the next one
+	typedef enum {
+		REGION_DTCM = 0,	// tightly-coupled, single-cycle, uncached
+		REGION_SRAM,		// AXI SRAM, cached
+		REGION_SDRAM,		// external SDRAM, cached
+		REGION_COUNT
+	} Region;
+
+	// each block is preceded by a header, which sits in the block's alignment padding
+	struct BlockHeader {
+		uint32_t size;		// bytes the block can hold
+		uint32_t prev_used;	// arena fill level before this block was allocated
+		uint32_t prev_top;	// offset of the block below this one (or OOPSY_ARENA_NONE)
+		uint32_t freed;
+		uint32_t next_free;	// offset of the next block in the free list (or OOPSY_ARENA_NONE)
+	};
+	static const uint32_t OOPSY_ARENA_NONE = 0xFFFFFFFF;
+
+	// a position in an arena that it can be rolled back to
+	struct ArenaMark {
+		uint32_t used, top, tail, tail_top;
+	};
+
+	// a block that has been replaced, but that the audio callback may still read until the next block
+	struct RetiredBlock {
+		void * p;
+		uint32_t block;		// the audio block count when it was replaced
+	};
+
+	// a bump allocator over a fixed block of memory
+	// a freed block at the top of the arena is reclaimed at once, along with any freed blocks below it;
+	// one further down goes on a free list (merged with any free neighbours), and is reused by the best-fitting allocation
+	// blocks below `floor` belong to the scope beneath the running app, so the app never reuses them
+	// while `from_tail` is set, blocks are taken from the end of the arena instead (for a second app, while crossfading);
+	// a freed one is reclaimed once every block taken after it is freed too (there is no free list there),
+	// and one can shrink but not grow in place
+	struct Arena {
+		const char * name = "";
+		char * base = nullptr;
+		uint32_t size = 0, used = 0, highwater = 0;
+		uint32_t top = OOPSY_ARENA_NONE; // offset of the most recent block
+		uint32_t tail = 0; // offset of the header of the lowest block taken from the end
+		uint32_t tail_top = OOPSY_ARENA_NONE; // offset of that block
+		uint32_t free_list = OOPSY_ARENA_NONE;
+		uint32_t floor = 0;
+		bool from_tail = false;
+		RetiredBlock retired[OOPSY_ARENA_RETIRED];
+		int retired_count = 0;
+
+		void init(const char * n, char * b, uint32_t s) {
+			name = n;
+			base = b;
+			size = b ? s : 0;
+			used = highwater = 0;
+			top = OOPSY_ARENA_NONE;
+			tail = size;
+			tail_top = OOPSY_ARENA_NONE;
+			free_list = OOPSY_ARENA_NONE;
+			floor = 0;
+			from_tail = false;
+			retired_count = 0;
+		}
+
+		inline uint32_t usable() const { return tail - used; }
+		inline uint32_t in_use() const { return used + (size - tail); }
+		inline bool contains(const void * p) const { return (const char *)p >= base && (const char *)p < base + size; }
+		inline BlockHeader * header(uint32_t offset) { return (BlockHeader *)(base + offset) - 1; }
+		// blocks released by a rollback have no header:
+		inline bool has_header(const void * p) const { return (const char *)p < base + used || in_tail(p); }
+		inline bool in_tail(const void * p) const { return (const char *)p > base + tail && (const char *)p < base + size; }
+
+		void * allocate(uint32_t bytes) {
+			if (from_tail) return allocate_tail(bytes);
+			void * reused = allocate_free(bytes);
+			if (reused) return reused;
+			uintptr_t start = (uintptr_t)(base + used) + sizeof(BlockHeader);
+			start = (start + (OOPSY_ALLOC_ALIGN-1)) & ~(uintptr_t)(OOPSY_ALLOC_ALIGN-1);
+			uint32_t offset = start - (uintptr_t)base;
+			if (!base || offset > tail || bytes > tail - offset) return nullptr;
+			BlockHeader * h = header(offset);
+			h->size = bytes;
+			h->prev_used = used;
+			h->prev_top = top;
+			h->freed = 0;
+			h->next_free = OOPSY_ARENA_NONE;
+			top = offset;
+			used = offset + bytes;
+			if (in_use() > highwater) highwater = in_use();
+			return base + offset;
+		}
+
+		// each block's header sits just below it, as for a block from the start;
+		// `prev_used` holds the tail before it, and `prev_top` the block taken before it
+		void * allocate_tail(uint32_t bytes) {
+			if (!base || bytes > tail - used) return nullptr;
+			// (the arena base is aligned, so aligning the offset aligns the block)
+			uint32_t offset = (tail - bytes) & ~(uint32_t)(OOPSY_ALLOC_ALIGN-1);
+			if (offset < used + sizeof(BlockHeader)) return nullptr;
+			BlockHeader * h = header(offset);
+			h->size = bytes;
+			h->prev_used = tail;
+			h->prev_top = tail_top;
+			h->freed = 0;
+			h->next_free = OOPSY_ARENA_NONE;
+			tail_top = offset;
+			tail = offset - sizeof(BlockHeader);
+			if (in_use() > highwater) highwater = in_use();
+			return base + offset;
+		}
+
+		void free_tail(uint32_t offset) {
+			BlockHeader * h = header(offset);
+			if (h->freed) return;
+			h->freed = 1;
+			// reclaim the lowest blocks, as far down as they are all freed:
+			while (tail_top != OOPSY_ARENA_NONE && header(tail_top)->freed) {
+				BlockHeader * b = header(tail_top);
+				tail = b->prev_used;
+				tail_top = b->prev_top;
+			}
+		}
+
+		// the smallest block on the free list that holds `bytes`, taken off the list
+		void * allocate_free(uint32_t bytes) {
+			uint32_t best = OOPSY_ARENA_NONE;
+			for (uint32_t at = free_list; at != OOPSY_ARENA_NONE; at = header(at)->next_free) {
+				uint32_t capacity = header(at)->size;
+				if (at >= floor && capacity >= bytes && (best == OOPSY_ARENA_NONE || capacity < header(best)->size)) best = at;
+			}
+			if (best == OOPSY_ARENA_NONE) return nullptr;
+			unlink_free(best);
+			header(best)->freed = 0;
+			return base + best;
+		}
+
+		void unlink_free(uint32_t offset) {
+			uint32_t * link = &free_list;
+			while (*link != OOPSY_ARENA_NONE && *link != offset) link = &header(*link)->next_free;
+			if (*link == offset) *link = header(offset)->next_free;
+		}
+
+		// drops blocks that are no longer below the fill level from the free list
+		void prune_free() {
+			uint32_t * link = &free_list;
+			while (*link != OOPSY_ARENA_NONE) {
+				if (*link >= used) {
+					*link = header(*link)->next_free;
+				} else {
+					link = &header(*link)->next_free;
+				}
+			}
+		}
+
+		// the block allocated just after the one at `offset` (or OOPSY_ARENA_NONE if it is the top)
+		uint32_t above(uint32_t offset) {
+			for (uint32_t at = top; at != OOPSY_ARENA_NONE; at = header(at)->prev_top) {
+				if (header(at)->prev_top == offset) return at;
+			}
+			return OOPSY_ARENA_NONE;
+		}
+
+		// extends the block at `lower` over the one at `upper`, which must be directly above it (and not the top)
+		void merge(uint32_t lower, uint32_t upper) {
+			header(lower)->size = upper + header(upper)->size - lower;
+			header(above(upper))->prev_top = lower;
+		}
+
+		void free(void * p) {
+			// ignore blocks that were already released by a rollback:
+			if (!has_header(p)) return;
+			uint32_t offset = (char *)p - base;
+			if (in_tail(p)) {
+				free_tail(offset);
+				return;
+			}
+			BlockHeader * h = header(offset);
+			if (h->freed) return;
+			h->freed = 1;
+			if (offset != top) {
+				// (a free block is never the top, so `up` has a block above it too)
+				uint32_t up = above(offset);
+				if (offset >= floor && header(up)->freed) {
+					unlink_free(up);
+					merge(offset, up);
+				}
+				uint32_t down = h->prev_top;
+				if (down != OOPSY_ARENA_NONE && down >= floor && header(down)->freed) {
+					merge(down, offset);
+				} else {
+					h->next_free = free_list;
+					free_list = offset;
+				}
+				return;
+			}
+			// reclaim any freed blocks at the top of the arena:
+			while (top != OOPSY_ARENA_NONE && header(top)->freed) {
+				BlockHeader * h = header(top);
+				used = h->prev_used;
+				top = h->prev_top;
+			}
+			prune_free();
+		}
+
+		// grows or shrinks the block at p where it is, if it can:
+		// within the space it already has, at the top of the arena, or over a free block just above it
+		bool resize(void * p, uint32_t bytes) {
+			if (!has_header(p)) return false;
+			uint32_t offset = (char *)p - base;
+			BlockHeader * h = header(offset);
+			// (one from the tail can only shrink, as anything below it was taken after it)
+			if (in_tail(p)) return bytes <= h->size;
+			if (bytes <= h->size && offset != top) return true;
+			// (the scope below doesn't get its blocks back, so a block of its own can't move the fill level)
+			if (offset < floor) return bytes <= h->size;
+			if (offset == top) {
+				if (bytes > tail - offset) return false;
+				h->size = bytes;
+				used = offset + bytes;
+				if (in_use() > highwater) highwater = in_use();
+				return true;
+			}
+			uint32_t up = above(offset);
+			BlockHeader * u = header(up);
+			if (!u->freed || bytes > up + u->size - offset) return false;
+			unlink_free(up);
+			merge(offset, up);
+			return true;
+		}
+
+		// bytes that can be read from p (for a block without a header, everything up to the end of the arena)
+		uint32_t capacity(const void * p) {
+			uint32_t offset = (const char *)p - base;
+			return has_header(p) ? header(offset)->size : size - offset;
+		}
+
+		// frees p once the audio callback has run a whole block since `block`
+		void retire(void * p, uint32_t block) {
+			// (if too many are waiting, the oldest is surely long out of use:)
+			if (retired_count == OOPSY_ARENA_RETIRED) {
+				free(retired[0].p);
+				retired_count--;
+				for (int i=0; i<retired_count; i++) retired[i] = retired[i+1];
+			}
+			retired[retired_count++] = RetiredBlock{ p, block };
+		}
+
+		void release_retired(uint32_t block) {
+			int kept = 0;
+			for (int i=0; i<retired_count; i++) {
+				if (block - retired[i].block >= 2) {
+					free(retired[i].p);
+				} else {
+					retired[kept++] = retired[i];
+				}
+			}
+			retired_count = kept;
+		}
+
+		ArenaMark mark() const { return ArenaMark{ used, top, tail, tail_top }; }
+
+		// forgets retired blocks in memory that a rollback has released
+		void drop_retired(const ArenaMark& m, bool from_end) {
+			int kept = 0;
+			for (int i=0; i<retired_count; i++) {
+				uint32_t offset = (char *)retired[i].p - base;
+				if (from_end ? offset >= m.tail : offset < m.used) retired[kept++] = retired[i];
+			}
+			retired_count = kept;
+		}
+
+		// discard every block allocated since mark `m` was taken
+		void rollback(const ArenaMark& m) {
+			used = m.used;
+			top = m.top;
+			floor = m.used;
+			highwater = in_use();
+			prune_free();
+			drop_retired(m, false);
+		}
+
+		// discard every block taken from the end since mark `m` was taken
+		void rollback_tail(const ArenaMark& m) {
+			tail = m.tail;
+			tail_top = m.tail_top;
+			highwater = in_use();
+			drop_retired(m, true);
+		}
+	};
+
+	Arena arenas[REGION_COUNT];
 	char * sram_pool = nullptr;
+	char DTCM_MEM_SECTION dtcm_pool[OOPSY_DTCM_SIZE];
 	char DSY_SDRAM_BSS sdram_pool[OOPSY_SDRAM_SIZE];
 
+	// the region that genlib_sysmem_newptr() will try first
+	Region placement = REGION_SRAM;
+
+	// a region for just the next allocation of exactly `bytes`, 
+	// e.g. the gen~ State, which is the first thing that create() allocates
+	Region placement_next = REGION_SRAM;
+	uint32_t placement_next_bytes = 0;
+
+	void place_next(uint32_t bytes, Region region) {
+		placement_next = region;
+		placement_next_bytes = bytes;
+	}
+
+	// preferred region for a named [data] or [delay], as planned by oopsy.js
+	struct Placement {
+		const char * name;
+		Region region;
+		const char * wavname; // if the [data] is loaded from a wav file, it can use the sample cache
+		bool planar;		  // (part of the data's shape in the sample cache)
+	};
+	const Placement * placements = nullptr;
+	int placement_count = 0;
+
+	void set_placements(const Placement * table, int count) {
+		placements = table;
+		placement_count = count;
+	}
+
+	const Placement * placement_lookup(const char * name) {
+		if (name) {
+			for (int i=0; i<placement_count; i++) {
+				if (strcmp(placements[i].name, name) == 0) return &placements[i];
+			}
+		}
+		return nullptr;
+	}
+
+	Region placement_for(const char * name) {
+		const Placement * p = placement_lookup(name);
+		return p ? p->region : placement;
+	}
+
+	// remembers the state of all arenas, so that everything allocated since can be released at once
+	// (used by GenDaisy::reset() to release an app's memory)
+	// a scope that uses the tail takes its blocks from the end of each arena, 
+	// so that it can be released while the scope below it is still in use
+	struct ArenaScope {
+		ArenaMark marks[REGION_COUNT];
+		bool tail = false;
+
+		void begin() {
+			for (int i=0; i<REGION_COUNT; i++) {
+				marks[i] = arenas[i].mark();
+				arenas[i].from_tail = tail;
+				if (!tail) arenas[i].floor = marks[i].used;
+			}
+		}
+
+		void rollback() {
+			for (int i=0; i<REGION_COUNT; i++) {
+				if (tail) {
+					arenas[i].rollback_tail(marks[i]);
+				} else {
+					arenas[i].rollback(marks[i]);
+				}
+			}
+		}
+	};
+
+	// Sample memory that outlives app switches, keyed by wav filename and [data] shape,
+	// so that apps sharing a sample file don't need to load it again.
+	// Blocks are placed first-fit within a region reserved from SDRAM at startup. 
+	// When no gap is big enough, the least recently used blocks that the current app isn't using are evicted.
+	struct SampleCache {
+		struct Entry {
+			const char * filename;	// (a string literal in the app code, so it is still valid after a switch), or null once invalidated
+			uint32_t offset, bytes, dim, channels, samplesize;
+			bool planar;
+			uint32_t frames;		// frames of the file held, once complete
+			uint32_t last_used;
+			uint32_t epoch;			// the app load that last acquired it
+			uint32_t complete;
+		};
+		char * base = nullptr;
+		uint32_t size = 0, used = 0;
+		Entry entries[OOPSY_SAMPLE_CACHE_ENTRIES];
+		int count = 0;
+		uint32_t clock = 0, epoch = 1;
+		uint32_t pinned = 0;		// the previous app's epoch, while it plays out a crossfade
+
+		void init(char * b, uint32_t s) {
+			base = b;
+			size = b ? s : 0;
+			used = 0;
+			count = 0;
+		}
+
+		inline bool contains(const void * p) const { return base && (const char *)p >= base && (const char *)p < base + size; }
+
+		Entry * find(const void * p) {
+			for (int i=0; i<count; i++) {
+				if (base + entries[i].offset == (const char *)p) return &entries[i];
+			}
+			return nullptr;
+		}
+
+		void remove(Entry * e) {
+			used -= e->bytes;
+			*e = entries[--count];
+		}
+
+		bool evict() {
+			Entry * lru = nullptr;
+			for (int i=0; i<count; i++) {
+				Entry& e = entries[i];
+				// (invalidated blocks hold nothing worth keeping, so they go first)
+				if (e.epoch != epoch && e.epoch != pinned && (!lru || (lru->filename && (!e.filename || e.last_used < lru->last_used)))) lru = &e;
+			}
+			if (!lru) return false;
+			remove(lru);
+			return true;
+		}
+
+		// the lowest offset with `bytes` free, or OOPSY_ARENA_NONE
+		uint32_t find_gap(uint32_t bytes) {
+			uint32_t start = 0;
+			while (bytes <= size && start <= size - bytes) {
+				// skip past everything that overlaps [start, start+bytes):
+				uint32_t next = OOPSY_ARENA_NONE;
+				for (int i=0; i<count; i++) {
+					const Entry& e = entries[i];
+					if (e.offset < start + bytes && e.offset + e.bytes > start) {
+						uint32_t end = e.offset + e.bytes;
+						if (next == OOPSY_ARENA_NONE || end > next) next = end;
+					}
+				}
+				if (next == OOPSY_ARENA_NONE) return start;
+				start = (next + (OOPSY_ALLOC_ALIGN-1)) & ~(uint32_t)(OOPSY_ALLOC_ALIGN-1);
+			}
+			return OOPSY_ARENA_NONE;
+		}
+
+		// memory for a [data] of this shape loaded from `filename`, or nullptr if it won't fit
+		// `preloaded` is set if the memory already holds the file
+		void * acquire(const char * filename, uint32_t dim, uint32_t channels, uint32_t samplesize, bool planar, int& preloaded) {
+			preloaded = 0;
+			if (!base) return nullptr;
+			uint32_t bytes = dim * channels * samplesize;
+			for (int i=0; i<count; i++) {
+				Entry& e = entries[i];
+				// (an entry already acquired by this app belongs to another [data] of the same file)
+				if (e.epoch != epoch && e.dim == dim && e.channels == channels && e.samplesize == samplesize && e.planar == planar && e.filename && strcmp(e.filename, filename) == 0) {
+					e.last_used = ++clock;
+					e.epoch = epoch;
+					preloaded = e.complete;
+					return base + e.offset;
+				}
+			}
+			if (count >= OOPSY_SAMPLE_CACHE_ENTRIES && !evict()) return nullptr;
+			uint32_t offset;
+			while ((offset = find_gap(bytes)) == OOPSY_ARENA_NONE) {
+				if (!evict()) return nullptr;
+			}
+			Entry& e = entries[count++];
+			e.filename = filename;
+			e.offset = offset;
+			e.bytes = bytes;
+			e.dim = dim;
+			e.channels = channels;
+			e.samplesize = samplesize;
+			e.planar = planar;
+			e.frames = 0;
+			e.last_used = ++clock;
+			e.epoch = epoch;
+			e.complete = 0;
+			used += bytes;
+			return base + offset;
+		}
+
+		// the file has been loaded into the block at p
+		void complete(const void * p, uint32_t frames) {
+			Entry * e = find(p);
+			if (!e || !e->filename) return;
+			e->frames = frames;
+			e->complete = 1;
+		}
+
+		// the block no longer holds a clean copy of its file; 
+		// its [data] is still using it, so it stays reserved (and unevictable) until released, but never matches a file again
+		void invalidate(const void * p) {
+			Entry * e = find(p);
+			if (!e) return;
+			e->filename = nullptr;
+			e->complete = 0;
+		}
+
+		// the block is no longer used by the current app, but remains cached (unless it was invalidated)
+		void release(const void * p) {
+			Entry * e = find(p);
+			if (!e) return;
+			if (e->filename) {
+				e->epoch = 0;
+			} else {
+				remove(e);
+			}
+		}
+
+		// the previous app's blocks become available for eviction,
+		// unless it is still playing (through a crossfade), in which case they are pinned until unpin()
+		void next_app(bool pin = false) { 
+			pinned = pin ? epoch : 0;
+			epoch++; 
+		}
+
+		void unpin() { pinned = 0; }
+
+		// gives up the current app's blocks (after a failed load, before it is tried again) and unpins the previous app's
+		void abandon() {
+			// (remove() moves the last entry down, which has already been visited)
+			for (int i=count-1; i>=0; i--) {
+				Entry& e = entries[i];
+				if (e.epoch != epoch) continue;
+				if (e.filename) {
+					e.epoch = 0;
+				} else {
+					remove(&e);
+				}
+			}
+			pinned = 0;
+		}
+	};
+	SampleCache sample_cache;
+
 	void init() {
 		if (!sram_pool) sram_pool = (char *)malloc(OOPSY_SRAM_SIZE);
-		sram_usable = OOPSY_SRAM_SIZE;
-		sram_used = 0;
-		sdram_usable = OOPSY_SDRAM_SIZE;
-		sdram_used = 0;
+		arenas[REGION_DTCM].init("dtcm", dtcm_pool, OOPSY_DTCM_SIZE);
+		arenas[REGION_SRAM].init("sram", sram_pool, OOPSY_SRAM_SIZE);
+		arenas[REGION_SDRAM].init("sdram", sdram_pool, OOPSY_SDRAM_SIZE);
+		placement = REGION_SRAM;
+		placement_next_bytes = 0;
+		set_placements(nullptr, 0);
+		// reserved before any app is loaded, so that it persists across app switches:
+		sample_cache.init((char *)arenas[REGION_SDRAM].allocate(OOPSY_SAMPLE_CACHE_BYTES), OOPSY_SAMPLE_CACHE_BYTES);
 	}
 
-	void * allocate(uint32_t size) {
-		if (size < sram_usable) {
-			void * p = sram_pool + sram_used;
-			sram_used += size;
-			sram_usable -= size;
-			return p;
-		} else if (size < sdram_usable) {
-			void * p = sdram_pool + sdram_used;
-			sdram_used += size;
-			sdram_usable -= size;
-			return p;
+	// counts allocations that found no space in any region
+	uint32_t allocate_failures = 0;
+
+	// allocate from the preferred region, or the next slower region that has space
+	void * allocate(uint32_t size, Region region) {
+		for (int i=region; i<REGION_COUNT; i++) {
+			void * p = arenas[i].allocate(size);
+			if (p) return p;
 		}
+		allocate_failures++;
 		return nullptr;
-	}	
+	}
+
+	void * allocate(uint32_t size) {
+		if (placement_next_bytes && size == placement_next_bytes) {
+			placement_next_bytes = 0;
+			return allocate(size, placement_next);
+		}
+		return allocate(size, placement);
+	}
+
+	void free(void * p) {
+		if (!p) return;
+		if (sample_cache.contains(p)) {
+			sample_cache.release(p);
+			return;
+		}
+		for (int i=0; i<REGION_COUNT; i++) {
+			if (arenas[i].contains(p)) {
+				arenas[i].free(p);
+				return;
+			}
+		}
+	}
+
+	// grows or shrinks the block at p where it is, if it can (a sample cache block never can)
+	bool resize(void * p, uint32_t size) {
+		if (!p || sample_cache.contains(p)) return false;
+		for (int i=0; i<REGION_COUNT; i++) {
+			if (arenas[i].contains(p)) return arenas[i].resize(p, size);
+		}
+		return false;
+	}
+
+	// the block at p resized, moving it within its region (and freeing the old one) if it can't be resized where it is
+	void * reallocate(void * p, uint32_t size) {
+		if (!p) return allocate(size);
+		if (resize(p, size)) return p;
+		uint32_t bytes = 0;
+		Region region = placement;
+		if (sample_cache.contains(p)) {
+			SampleCache::Entry * e = sample_cache.find(p);
+			if (e) bytes = e->bytes;
+			region = REGION_SDRAM;
+		} else {
+			for (int i=0; i<REGION_COUNT; i++) {
+				if (arenas[i].contains(p)) {
+					bytes = arenas[i].capacity(p);
+					region = Region(i);
+				}
+			}
+		}
+		void * moved = allocate(size, region);
+		if (!moved) return nullptr;
+		memcpy(moved, p, bytes < size ? bytes : size);
+		free(p);
+		return moved;
+	}
+
+	// frees p once the audio callback has run a whole block since audio block `block`, 
+	// for memory that the callback may still be reading
+	void retire(void * p, uint32_t block) {
+		if (!p) return;
+		if (sample_cache.contains(p)) {
+			// (cached blocks are only evicted by a later app load)
+			sample_cache.release(p);
+			return;
+		}
+		for (int i=0; i<REGION_COUNT; i++) {
+			if (arenas[i].contains(p)) {
+				arenas[i].retire(p, block);
+				return;
+			}
+		}
+	}
+
+	void release_retired(uint32_t block) {
+		for (int i=0; i<REGION_COUNT; i++) arenas[i].release_retired(block);
+	}
+
+	// prints a byte count as e.g. "512B", "12K", "64M"
+	int format_bytes(char * buf, size_t len, uint32_t bytes) {
+		if (bytes < 1024) return snprintf(buf, len, "%uB", (unsigned)bytes);
+		if (bytes < 1048576) return snprintf(buf, len, "%uK", (unsigned)((bytes + 1023)/1024));
+		return snprintf(buf, len, "%uM", (unsigned)((bytes + 1048575)/1048576));
+	}
 
 	void memset(void *p, int c, long size) {
 		char *p2 = (char *)p;
+		#ifdef GENLIB_USE_ARMMATH
+		// arena blocks are 32-byte aligned, so fill whole words and finish the tail bytewise:
+		if (((uintptr_t)p2 & 3) == 0 && size >= 4) {
+			long words = size / 4;
+			arm_fill_q31((q31_t)(0x01010101u * (uint8_t)c), (q31_t *)p2, words);
+			p2 += words * 4;
+			size -= words * 4;
+		}
+		#endif
 		int i;
 		for (i = 0; i < size; i++, p2++) *p2 = char(c);
 	}
@@ -126,10 +834,530 @@ namespace oopsy {
 		}
 	};
 
+	#ifdef OOPSY_TARGET_USES_MIDI_UART
+	// a single-producer, single-consumer byte queue: the audio callback pushes, the main loop pops.
+	// the indices run freely and wrap by masking, so N must be a power of two:
+	template<uint32_t N>
+	struct MidiOutQueue {
+		static_assert((N & (N-1)) == 0, "MidiOutQueue size must be a power of two");
+		uint8_t data[N];
+		volatile uint32_t write = 0, read = 0;
+
+		bool empty() const { return read == write; }
+		uint32_t space() const { return N - (write - read); }
+		void clear() { read = write; }
+
+		bool push(uint8_t b0) {
+			if (space() < 1) return false;
+			data[write & (N-1)] = b0;
+			publish(1);
+			return true;
+		}
+		bool push(uint8_t b0, uint8_t b1) {
+			if (space() < 2) return false;
+			data[write & (N-1)] = b0;
+			data[(write+1) & (N-1)] = b1;
+			publish(2);
+			return true;
+		}
+		bool push(uint8_t b0, uint8_t b1, uint8_t b2) {
+			if (space() < 3) return false;
+			data[write & (N-1)] = b0;
+			data[(write+1) & (N-1)] = b1;
+			data[(write+2) & (N-1)] = b2;
+			publish(3);
+			return true;
+		}
+		uint8_t pop() {
+			uint8_t b = data[read & (N-1)];
+			read = read + 1;
+			return b;
+		}
+		void publish(uint32_t n) {
+			// the bytes must be written before the consumer can see them:
+			__asm__ volatile("" ::: "memory");
+			write = write + n;
+		}
+	};
+	#endif
+
+	#ifdef OOPSY_HAS_LOG
+	// a log message waiting to be formatted: its format string (which must outlive the message, e.g. a literal),
+	// a formatter for the types of its arguments, and the arguments themselves packed as bytes
+	struct LogEntry {
+		const char * fmt;
+		int (*format)(char * buf, size_t len, const LogEntry& entry);
+		volatile uint32_t ready;
+		bool truncated;	// some arguments didn't fit, and are cut short or left out
+		uint8_t args[OOPSY_LOG_ARG_BYTES];
+	};
+
+	// how an argument is packed into a LogEntry, and passed to snprintf when it is formatted.
+	// an argument that doesn't fit in what is left of the entry is left out, and unpacks as zero:
+	template<typename T>
+	struct LogArg {
+		typedef T type;
+		static uint8_t * pack(uint8_t * p, const uint8_t * end, T v, bool& truncated) {
+			if (p + sizeof(T) > end) {
+				truncated = true;
+				return (uint8_t *)end;
+			}
+			memcpy(p, &v, sizeof(T));
+			return p + sizeof(T);
+		}
+		static T unpack(const uint8_t *& p, const uint8_t * end) {
+			T v = T();
+			if (p + sizeof(T) > end) return v;
+			memcpy(&v, p, sizeof(T));
+			p += sizeof(T);
+			return v;
+		}
+	};
+
+	// strings are copied (truncated to fit), since the caller's buffer may change before the main loop formats them:
+	template<>
+	struct LogArg<const char *> {
+		typedef const char * type;
+		static uint8_t * pack(uint8_t * p, const uint8_t * end, const char * v, bool& truncated) {
+			if (p >= end) {
+				truncated = true;
+				return (uint8_t *)end;
+			}
+			size_t n = 0, room = end - p - 1;
+			if (v) while (n < room && v[n]) { p[n] = v[n]; n++; }
+			if (v && v[n]) truncated = true;
+			p[n] = 0;
+			return p + n + 1;
+		}
+		static const char * unpack(const uint8_t *& p, const uint8_t * end) {
+			if (p >= end) return "";
+			const char * v = (const char *)p;
+			p += strlen(v) + 1;
+			return v;
+		}
+	};
+	template<> struct LogArg<char *> : public LogArg<const char *> {};
+
+	// floats are stored as floats, and passed as doubles as printf expects:
+	template<>
+	struct LogArg<float> : public LogArg<double> {
+		typedef double type;
+		static uint8_t * pack(uint8_t * p, const uint8_t * end, float v, bool& truncated) { return LogArg<double>::pack(p, end, v, truncated); }
+	};
+
+	// unpacks each argument in turn, then formats them all:
+	template<typename... Args> struct LogFormat;
+	template<>
+	struct LogFormat<> {
+		template<typename... Vs>
+		static int format(char * buf, size_t len, const char * fmt, const uint8_t * p, const uint8_t * end, Vs... vs) {
+			return snprintf(buf, len, fmt, vs...);
+		}
+	};
+	template<typename T, typename... Rest>
+	struct LogFormat<T, Rest...> {
+		template<typename... Vs>
+		static int format(char * buf, size_t len, const char * fmt, const uint8_t * p, const uint8_t * end, Vs... vs) {
+			typename LogArg<T>::type v = LogArg<T>::unpack(p, end);
+			return LogFormat<Rest...>::format(buf, len, fmt, p, end, vs..., v);
+		}
+	};
+
+	template<typename... Args>
+	int log_format(char * buf, size_t len, const LogEntry& entry) {
+		return LogFormat<Args...>::format(buf, len, entry.fmt, entry.args, entry.args + OOPSY_LOG_ARG_BYTES);
+	}
+
+	// a multi-producer, single-consumer ring of log messages: the audio callback and the main loop reserve entries,
+	// and the main loop formats them. a full ring drops the message and counts it.
+	// the indices run freely and wrap by masking, so N must be a power of two:
+	template<uint32_t N>
+	struct LogRing {
+		static_assert((N & (N-1)) == 0, "LogRing size must be a power of two");
+		LogEntry entries[N];
+		uint32_t write = 0, read = 0;
+		uint32_t dropped = 0;
+
+		LogEntry * reserve() {
+			uint32_t w = __atomic_load_n(&write, __ATOMIC_RELAXED);
+			do {
+				if (w - __atomic_load_n(&read, __ATOMIC_ACQUIRE) >= N) {
+					__atomic_add_fetch(&dropped, 1u, __ATOMIC_RELAXED);
+					return nullptr;
+				}
+			} while (!__atomic_compare_exchange_n(&write, &w, w + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+			return &entries[w & (N-1)];
+		}
+
+		// the entry must be filled in before the consumer can see it:
+		void publish(LogEntry * entry) { __atomic_store_n(&entry->ready, 1u, __ATOMIC_RELEASE); }
+
+		// the oldest message, once it is complete (or null)
+		const LogEntry * front() const {
+			if (read == __atomic_load_n(&write, __ATOMIC_ACQUIRE)) return nullptr;
+			const LogEntry * entry = &entries[read & (N-1)];
+			return __atomic_load_n(&entry->ready, __ATOMIC_ACQUIRE) ? entry : nullptr;
+		}
+
+		void pop() {
+			entries[read & (N-1)].ready = 0;
+			__atomic_store_n(&read, read + 1, __ATOMIC_RELEASE);
+		}
+	};
+	#endif // OOPSY_HAS_LOG
+
+	#ifdef OOPSY_CONTROL_TASK
+	// the control task writes the back buffer and publishes it; the audio callback reads the front.
+	// the audio interrupt preempts the control task, so it never sees a half-written snapshot:
+	template<typename T>
+	struct DoubleBuffer {
+		T buffers[2];
+		volatile uint8_t front;
+
+		// no constructor, as apps live in a union:
+		void reset() { front = 0; }
+		T& back() { return buffers[front ^ 1]; }
+		const T& read() const { return buffers[front]; }
+		void publish() {
+			// the back buffer writes must not be reordered past the flip:
+			__asm__ volatile("" ::: "memory");
+			front ^= 1;
+		}
+	};
+	#endif
+
+	#ifdef OOPSY_VOICES
+	// assigns MIDI notes to the copies of a polyphonic app's gen~ voice, and tracks which of them are sounding.
+	// a voice sounds from its note on until its level falls silent after its note off;
+	// the app only performs the voices that are sounding
+	template<int N>
+	struct VoiceAllocator {
+		struct Voice {
+			uint8_t note, chan;
+			bool held;			// between its note on and note off
+			bool sounding;
+			bool retrigger;		// it was still held when it got a new note, so its gate must fall for a block first
+			uint32_t started;	// for stealing the oldest
+			uint32_t quiet;		// frames it has been silent for since its release
+			float level;		// peak of its last block
+		};
+		Voice voices[N];
+		uint32_t clock;
+
+		// no constructor, as apps live in a union:
+		void reset() {
+			for (int v=0; v<N; v++) voices[v] = Voice{ 0, 0, false, false, false, 0, 0, 0.f };
+			clock = 0;
+		}
+
+		inline bool sounding(int v) const { return voices[v].sounding; }
+
+		// the voice to play a note: one already sounding the same note, else a silent one, else one to steal (or -1)
+		int note_on(uint8_t note, uint8_t chan) {
+			int v = find(note, chan);
+			if (v < 0) {
+				for (int i=0; i<N; i++) {
+					if (!voices[i].sounding) { v = i; break; }
+				}
+			}
+			if (v < 0) v = steal();
+			if (v < 0) return -1;
+			voices[v].note = note;
+			voices[v].chan = chan;
+			voices[v].retrigger = voices[v].held;
+			voices[v].held = voices[v].sounding = true;
+			voices[v].started = ++clock;
+			voices[v].quiet = 0;
+			return v;
+		}
+
+		// the voice that was holding this note, or -1
+		int note_off(uint8_t note, uint8_t chan) {
+			for (int v=0; v<N; v++) {
+				if (voices[v].held && voices[v].note == note && voices[v].chan == chan) {
+					voices[v].held = false;
+					return v;
+				}
+			}
+			return -1;
+		}
+
+		// releases a voice's note, if it was holding one
+		bool release(int v) {
+			if (!voices[v].held) return false;
+			voices[v].held = false;
+			return true;
+		}
+
+		int find(uint8_t note, uint8_t chan) const {
+			for (int v=0; v<N; v++) {
+				if (voices[v].sounding && voices[v].note == note && voices[v].chan == chan) return v;
+			}
+			return -1;
+		}
+
+		// released voices first, then (unless stealing is off) held ones
+		int steal() const {
+			int best = -1;
+			for (int pass=0; pass<2 && best < 0; pass++) {
+				#if (OOPSY_VOICE_STEAL == OOPSY_VOICE_STEAL_NONE)
+				if (pass) break;
+				#endif
+				for (int v=0; v<N; v++) {
+					const Voice& x = voices[v];
+					if (x.held != (pass == 1)) continue;
+					#if (OOPSY_VOICE_STEAL == OOPSY_VOICE_STEAL_QUIETEST)
+					if (best < 0 || x.level < voices[best].level) best = v;
+					#else
+					if (best < 0 || x.started < voices[best].started) best = v;
+					#endif
+				}
+			}
+			return best;
+		}
+
+		// after a voice has performed a block of `size` frames, with the peak level it reached:
+		void performed(int v, float level, size_t size) {
+			Voice& x = voices[v];
+			x.level = level;
+			if (x.held || level >= OOPSY_VOICE_SILENCE) {
+				x.quiet = 0;
+			} else if ((x.quiet += size) >= OOPSY_VOICE_SILENT_FRAMES) {
+				x.sounding = false;
+			}
+		}
+	};
+
+	// adds a voice's block of outputs into the app's outputs, returning the voice's peak level
+	float voice_mix(float ** voice_outs, float ** outs, int count, size_t size) {
+		float peak = 0.f;
+		for (int c=0; c<count; c++) {
+			const float * src = voice_outs[c];
+			float * dst = outs[c];
+			for (size_t i=0; i<size; i++) {
+				float v = src[i];
+				dst[i] += v;
+				v = fabsf(v);
+				if (v > peak) peak = v;
+			}
+		}
+		return peak;
+	}
+	#endif
+
+	#ifdef OOPSY_IDLE_HOLD_MS
+	// the peak level of a block of several buffers
+	float block_peak(float ** bufs, int count, size_t size) {
+		float peak = 0.f;
+		for (int c=0; c<count; c++) {
+			const float * buf = bufs[c];
+			for (size_t i=0; i<size; i++) {
+				float v = fabsf(buf[i]);
+				if (v > peak) peak = v;
+			}
+		}
+		return peak;
+	}
+
+	// decides when an app has been silent for long enough to stop performing it:
+	// any activity wakes it for at least the hold time
+	struct IdleDetect {
+		uint32_t hold;	// frames of silence before going idle
+		uint32_t quiet;	// frames of silence so far
+		bool idle;
+
+		// no constructor, as apps live in a union:
+		void reset(uint32_t hold_frames) {
+			hold = hold_frames;
+			quiet = 0;
+			idle = false;
+		}
+
+		// before a block: whether its perform can be skipped
+		inline bool skip(bool woken) {
+			if (woken) {
+				quiet = 0;
+				idle = false;
+			}
+			return idle;
+		}
+
+		// after performing a block of `size` frames, with the peak level of its outputs:
+		inline void performed(float peak, size_t size) {
+			if (peak >= OOPSY_IDLE_SILENCE) {
+				quiet = 0;
+			} else if ((quiet += size) >= hold) {
+				idle = true;
+			}
+		}
+	};
+	#endif
+
+	// denormals flush to zero and NaN results are the default NaN, both in the main loop (FPSCR)
+	// and in interrupt handlers such as the audio callback, which start from FPDSCR instead:
+	void fpu_flush_to_zero() {
+		const uint32_t bits = FPU_FPDSCR_FZ_Msk | FPU_FPDSCR_DN_Msk;
+		FPU->FPDSCR |= bits;
+		__set_FPSCR(__get_FPSCR() | bits);
+	}
+
+	#if defined(OOPSY_USE_PROFILER) || defined(OOPSY_BENCH)
+	// enable the DWT cycle counter (the M7 DWT needs unlocking first)
+	void cycle_counter_start() {
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->LAR = 0xC5ACCE55;
+		DWT->CYCCNT = 0;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	}
+
+	inline uint32_t cycle_count() { return DWT->CYCCNT; }
+	#endif
+
+	#ifdef OOPSY_USE_PROFILER
+	// stages of the audio callback, timed in CPU cycles with the DWT cycle counter
+	typedef enum {
+		PROFILE_CONTROLS = 0,	// audio_preperform (ProcessAllControls, menu) and the param scan
+		PROFILE_PERFORM,		// gen.perform
+		PROFILE_EPILOGUE,		// generated MIDI/CV/gate outputs and output copies
+		PROFILE_POST,			// audio_postperform (scope, streams)
+		PROFILE_TOTAL,			// the whole callback
+		PROFILE_COUNT
+	} ProfileStage;
+
+	// histogram bins are eighths of the block's cycle budget, plus one for anything over budget
+	#define OOPSY_PROFILE_BINS (9)
+
+	struct Profiler {
+		struct Stats {
+			uint32_t min, max, count;
+			uint64_t sum;
+			uint32_t bins[OOPSY_PROFILE_BINS];
+
+			void add(uint32_t cycles, uint32_t budget) {
+				if (cycles < min) min = cycles;
+				if (cycles > max) max = cycles;
+				sum += cycles;
+				count++;
+				uint32_t bin = budget ? (uint32_t)(((uint64_t)cycles * 8) / budget) : 0;
+				bins[bin < OOPSY_PROFILE_BINS-1 ? bin : OOPSY_PROFILE_BINS-1]++;
+			}
+
+			inline uint32_t avg() const { return count ? (uint32_t)(sum / count) : 0; }
+		};
+
+		static const char * name(int stage) {
+			static const char * names[PROFILE_COUNT] = { "ctl", "dsp", "out", "pst", "all" };
+			return names[stage];
+		}
+
+		Stats stats[PROFILE_COUNT];
+		uint32_t budget = 0;	// cycles available per audio block
+		uint32_t start = 0, mark = 0;
+		// a stage's cycles in the current block, added up over every app that runs it (two, while crossfading):
+		uint32_t block_cycles[PROFILE_COUNT];
+		uint32_t lapped = 0;	// a bit for each stage that has a lap in the current block
+		uint32_t xruns = 0;		// blocks that took longer than the budget
+		uint32_t idle = 0;		// blocks that an idle app didn't perform
+		volatile bool reset_requested = false;
+
+		void init(uint32_t cycles_per_block) {
+			cycle_counter_start();
+			budget = cycles_per_block;
+			reset();
+		}
+
+		void reset() {
+			for (int i=0; i<PROFILE_COUNT; i++) {
+				Stats& st = stats[i];
+				st.min = 0xFFFFFFFF;
+				st.max = st.count = 0;
+				st.sum = 0;
+				for (int b=0; b<OOPSY_PROFILE_BINS; b++) st.bins[b] = 0;
+			}
+			xruns = idle = 0;
+			reset_requested = false;
+		}
+
+		static inline uint32_t now() { return cycle_count(); }
+
+		// called from the audio callback:
+		inline void begin() {
+			if (reset_requested) reset();
+			lapped = 0;
+			start = mark = now();
+		}
+
+		// attribute the cycles since the previous mark to a stage:
+		inline void lap(ProfileStage stage) {
+			uint32_t t = now();
+			uint32_t bit = 1u << stage;
+			if (!(lapped & bit)) {
+				lapped |= bit;
+				block_cycles[stage] = 0;
+			}
+			block_cycles[stage] += t - mark;
+			mark = t;
+		}
+
+		// each stage counts once per block:
+		inline void end() {
+			for (int i=0; i<PROFILE_TOTAL; i++) {
+				if (lapped & (1u << i)) stats[i].add(block_cycles[i], budget);
+			}
+			uint32_t cycles = now() - start;
+			stats[PROFILE_TOTAL].add(cycles, budget);
+			if (cycles > budget) xruns++;
+		}
+
+		// the histogram of a stage as one character per bin
+		int format_histogram(char * buf, size_t len, int stage) const {
+			static const char levels[] = " .:-=+*#";
+			const Stats& st = stats[stage];
+			uint32_t peak = 1;
+			for (int b=0; b<OOPSY_PROFILE_BINS; b++) if (st.bins[b] > peak) peak = st.bins[b];
+			int offset = snprintf(buf, len, "%-3s", name(stage));
+			for (int b=0; b<OOPSY_PROFILE_BINS && offset+1 < (int)len; b++) {
+				// any non-empty bin shows at least a dot:
+				uint32_t level = st.bins[b] ? 1 + (st.bins[b] * 6) / peak : 0;
+				buf[offset++] = levels[level];
+			}
+			buf[offset] = 0;
+			return offset;
+		}
+
+		inline unsigned permille(uint32_t cycles) const {
+			return budget ? (unsigned)(((uint64_t)cycles * 1000) / budget) : 0;
+		}
+	};
+	#endif // OOPSY_USE_PROFILER
+
 	struct AppDef {
 		const char * name;
 		void (*load)();
 	};
+
+	#ifdef OOPSY_USE_SNAPSHOTS
+	// precedes a snapshot in QSPI flash
+	struct SnapshotHeader {
+		uint32_t magic;
+		uint32_t key;		// the app's name and the shape of its params & tables, so that a changed patch doesn't restore
+		uint32_t bytes;		// of the payload: the param state, then each table
+		uint32_t checksum;	// of the payload
+	};
+
+	// memory saved in an app's snapshot, e.g. a [data foo_snapshot]
+	struct SnapshotTable {
+		void * data;
+		uint32_t bytes;
+	};
+
+	// FNV-1a
+	uint32_t snapshot_hash(uint32_t h, const void * p, uint32_t bytes) {
+		const uint8_t * b = (const uint8_t *)p;
+		for (uint32_t i=0; i<bytes; i++) h = (h ^ b[i]) * 16777619u;
+		return h;
+	}
+	#endif
 	typedef enum {
 		#ifdef OOPSY_TARGET_HAS_OLED
 			MODE_SCOPE,
@@ -137,6 +1365,9 @@ namespace oopsy {
 				MODE_PARAMS,
 			#endif
 			MODE_CONSOLE,
+			#ifdef OOPSY_USE_PROFILER
+				MODE_PROFILE,
+			#endif
 		#endif
 		#ifdef OOPSY_MULTI_APP
 			MODE_MENU,
@@ -144,7 +1375,11 @@ namespace oopsy {
 		MODE_COUNT
 	} Mode;
 
-	
+	#ifdef OOPSY_TARGET_USES_MIDI_UART
+	// the UART receives MIDI into this by DMA, so it must be in memory the DMA can reach, and uncached:
+	static uint8_t DMA_BUFFER_MEM_SECTION midi_rx_buffer[OOPSY_MIDI_RX_BUFFER_SIZE];
+	static uint8_t DMA_BUFFER_MEM_SECTION midi_tx_buffer[OOPSY_MIDI_TX_BATCH];
+	#endif
 
 	struct GenDaisy {
 
@@ -170,15 +1405,52 @@ namespace oopsy {
 
 		// percent (0-100) of available processing time used
 		float audioCpuUsage = 0; 
+		#ifdef OOPSY_USE_PROFILER
+		Profiler profiler;
+		#endif
 
 		void (*mainloopCallback)(uint32_t t, uint32_t dt);
 		void (*displayCallback)(uint32_t t, uint32_t dt);
+		#ifdef OOPSY_CONTROL_TASK
+		void (*controlCallback)();
+		uint32_t control_us = 0;
+		#endif
 		#ifdef OOPSY_HAS_PARAM_VIEW
 		void (*paramCallback)(int idx, char * label, int len, bool tweak);
 		#endif
 		void * app = nullptr;
 		void * gen = nullptr;
+		// everything allocated by the running app, released on reset():
+		ArenaScope app_scope;
 		bool nullAudioCallbackRunning = false;
+		// set while an outgoing app's audio callback runs during a crossfade, to mute its MIDI:
+		bool app_fading = false;
+		#ifdef OOPSY_USE_SNAPSHOTS
+		// the running app's state functions and snapshot tables, set by its init:
+		size_t (*snapshot_statesize)(CommonState *) = nullptr;
+		short (*snapshot_getstate)(CommonState *, char *) = nullptr;
+		short (*snapshot_setstate)(CommonState *, const char *) = nullptr;
+		SnapshotTable snapshot_tables[OOPSY_SNAPSHOT_TABLES];
+		int snapshot_table_count = 0, snapshot_save_scheduled = 0;
+		#endif
+		#if (OOPSY_APP_SLOTS > 1)
+		// the outgoing app plays on, with its memory at the other end of the arenas, until the crossfade is done:
+		ArenaScope fade_scope;
+		void * fade_app = nullptr;
+		void * fade_gen = nullptr;
+		daisy::AudioHandle::AudioCallback fade_perform = nullptr, app_perform = nullptr, app_callback = nullptr;
+		// blocks of crossfade left; -1 while the next app is being prepared:
+		volatile int fade_remaining = 0;
+		int app_slot = 0;
+		float fade_buffers[OOPSY_IO_COUNT][OOPSY_BLOCK_SIZE];
+		#ifdef OOPSY_TARGET_USES_SDMMC
+		// the outgoing app's loads and streams come first in the queues, and are stopped once the crossfade is done:
+		int fade_load_count = 0, fade_stream_count = 0;
+		uint8_t * fade_load_workspace = nullptr;
+		// while the incoming app is being prepared, only the outgoing app's streams are advanced (else -1, all of them):
+		volatile int stream_advance_count = -1;
+		#endif
+		#endif
 		
 		#ifdef OOPSY_TARGET_HAS_OLED
 
@@ -198,17 +1470,35 @@ namespace oopsy {
 		} ScopeOptions;
 		
 		FontDef& font = Font_6x8;
-		uint_fast8_t scope_zoom = 7; 
-		uint_fast8_t scope_step = 0; 
+		uint_fast8_t scope_zoom = 6; // 16 samples per pixel (see scope_samples())
 		uint_fast8_t scope_option = 0, scope_style = SCOPESTYLE_TOPBOTTOM, scope_source = OOPSY_IO_COUNT/2;
 		uint16_t console_cols, console_rows, console_line;
 		char * console_stats;
 		char * console_memory;
 		char ** console_lines;
-		float scope_data[OOPSY_OLED_DISPLAY_WIDTH*2][2]; // 128 pixels
+		// retained-mode display: a hash of what is on screen in each text row and the stats corner,
+		// so that a frame only redraws what changed, and is only sent to the display if anything did
+		uint32_t * display_rows;
+		uint32_t display_stats_hash = 0;
+		int display_stats_len = 0;
+		char * display_blank;
+		int display_mode = -1, display_selecting = -1;
+		bool display_dirty = true;
+		float scope_data[OOPSY_OLED_DISPLAY_WIDTH*2][2]; // min & max per pixel, per channel
+		float * scope_ring[2] = { nullptr, nullptr };
+		volatile uint32_t scope_ring_write = 0;
 		char scope_label[11];
 		#endif // OOPSY_TARGET_HAS_OLED
 
+		#ifdef OOPSY_HAS_LOG
+		LogRing<OOPSY_LOG_RING_SIZE> log_ring;
+		uint32_t log_dropped = 0;	// the ring's drop count, as last reported
+		#ifdef OOPSY_LOG_SERIAL
+		uint32_t log_serial_dropped = 0, log_serial_reported = 0;	// lines USB serial refused
+		uint8_t log_serial_buffer = 0;	// which of log_line()'s buffers was last sent
+		#endif
+		#endif
+
 		#ifdef OOPSY_TARGET_USES_MIDI_UART
 
 		struct MidiNote {
@@ -238,11 +1528,11 @@ namespace oopsy {
 				vel = v;
 			}
 
-			// call in the throttled section (if a pressure output was defined)
-			void update_pressure(GenDaisy& daisy, uint8_t pressure) {
+			// call at block rate (if a pressure output was defined); only the latest pressure is sent
+			void update_pressure(GenDaisy& daisy, int slot, uint8_t pressure) {
 				if (vel && pressure != press) {
 					// send pressure
-					daisy.midi_message3(160 + chan, pitch, pressure);
+					daisy.midi_coalesce(slot, 160 + chan, pitch, pressure);
 				}
 				press = pressure;
 			}
@@ -255,17 +1545,59 @@ namespace oopsy {
 		} midi;
 
 		daisy::UartHandler uart;
-		uint32_t midi_out_writeidx = 0;
-		uint32_t midi_out_readidx = 0;
-
-		uint8_t midi_in_written = 0;//, midi_out_written = 0;
+		// a DMA transmit is in flight, until its completion callback:
+		volatile bool midi_tx_busy = false;
+		MidiOutQueue<OOPSY_MIDI_BUFFER_SIZE> midi_out;
+		MidiOutQueue<OOPSY_MIDI_REALTIME_SIZE> midi_out_realtime;
+		// the latest message of each continuous output, packed as status | b1<<8 | b2<<16, or 0 if already sent:
+		volatile uint32_t midi_out_slots[OOPSY_MIDI_OUT_SLOTS];
+		int midi_out_slot_next = 0;
+		// the state of the outgoing byte stream: running status, 
+		// data bytes still due for the current message, and whether a sysex is open
+		uint8_t midi_out_status = 0, midi_out_due = 0;
+		bool midi_out_sysex = false;
+		// a coalesced message being sent:
+		uint8_t midi_out_msg[3], midi_out_msg_len = 0, midi_out_msg_pos = 0;
+
+		uint16_t midi_in_written = 0;//, midi_out_written = 0;
 		uint8_t midi_in_active = 0, midi_out_active = 0;
-		uint8_t midi_out_data[OOPSY_MIDI_BUFFER_SIZE];
 		float midi_in_data[OOPSY_BLOCK_SIZE];
 		int midi_data_idx = 0;
 		int midi_parse_state = 0;
+
+		// bytes stamped with the sample clock by the UART's receive interrupt,
+		// and handed to the app at the start of the next audio block:
+		struct MidiInByte {
+			uint32_t frame;
+			uint8_t byte;
+		};
+		MidiInByte midi_in_queue[OOPSY_MIDI_IN_QUEUE_SIZE];
+		volatile uint32_t midi_in_queue_write = 0, midi_in_queue_read = 0;
+		// the same bytes for the main loop, which handles thru, reboot (0xFF) and program changes outside of any interrupt:
+		uint8_t midi_in_main[OOPSY_MIDI_IN_QUEUE_SIZE];
+		volatile uint32_t midi_in_main_write = 0, midi_in_main_read = 0;
+		uint8_t midi_in_main_status = 0;
+		// thru is copied to its own queue in whole messages (with running status restored),
+		// and sent between the app's messages:
+		bool midi_thru = false;
+		MidiOutQueue<OOPSY_MIDI_BUFFER_SIZE> midi_out_thru;
+		bool midi_out_thru_open = false;
+		// the thru parser: running status, a message being gathered, and whether a sysex is open
+		uint8_t midi_thru_status = 0, midi_thru_msg[3], midi_thru_len = 0, midi_thru_due = 0;
+		bool midi_thru_sysex = false;
+		// the sample clock: the frame the current block started at, and when (in us)
+		volatile uint32_t midi_clock = 0, midi_clock_us = 0;
+		// the frame the previous block started at, which the queued bytes are delivered against:
+		uint32_t midi_in_block_frame = 0;
+		uint32_t midi_block_size = OOPSY_BLOCK_SIZE;
+		float midi_frames_per_us = OOPSY_SAMPLERATE * 1e-6f;
 		#endif //OOPSY_TARGET_USES_MIDI_UART
 
+		// shared by every app's routing: silence for gen~ inputs with no source,
+		// and somewhere to write gen~ outputs that go nowhere
+		float zero_buffer[OOPSY_BLOCK_SIZE] = {};
+		float discard_buffer[OOPSY_BLOCK_SIZE];
+
 		#ifdef OOPSY_TARGET_USES_SDMMC
 		struct WavFormatChunk {
 			uint32_t size; 			// 16
@@ -279,6 +1611,27 @@ namespace oopsy {
 
 		// at minimum this should fit one frame of 4 bytes-per-sample x numchans
 		#define OOPSY_WAV_WORKSPACE_BYTES (256)
+		// how much of a streamed wav file is read from the card per main loop pass
+		#ifndef OOPSY_WAV_STREAM_CHUNK_BYTES
+		#define OOPSY_WAV_STREAM_CHUNK_BYTES (4096)
+		#endif
+		#ifndef OOPSY_MAX_WAV_STREAMS
+		#define OOPSY_MAX_WAV_STREAMS (4)
+		#endif
+		// how much is read from the card at a time when loading a whole wav file
+		#ifndef OOPSY_WAV_LOAD_BYTES
+		#define OOPSY_WAV_LOAD_BYTES (32 * 1024)
+		#endif
+		#ifndef OOPSY_MAX_WAV_LOADS
+		#define OOPSY_MAX_WAV_LOADS (32)
+		#endif
+		// the 1-bit bus works with every card & board; 4 bits is up to 4x faster where it is wired
+		#ifndef OOPSY_SDMMC_BUS_WIDTH
+		#define OOPSY_SDMMC_BUS_WIDTH (1)
+		#endif
+		#ifndef OOPSY_SDMMC_MHZ
+		#define OOPSY_SDMMC_MHZ (50)
+		#endif
 
 		daisy::SdmmcHandler handler;
 		daisy::FatFSInterface fsi;
@@ -289,142 +1642,705 @@ namespace oopsy {
 			daisy::SdmmcHandler::Config sdconfig;
 			sdconfig.Defaults(); // 4-bit, 50MHz
 			// sdconfig.clock_powersave = false;
-			// sdconfig.speed           = daisy::SdmmcHandler::Speed::FAST;
+			#if OOPSY_SDMMC_MHZ >= 100
+			sdconfig.speed           = daisy::SdmmcHandler::Speed::VERY_FAST;
+			#elif OOPSY_SDMMC_MHZ >= 50
+			sdconfig.speed           = daisy::SdmmcHandler::Speed::FAST;
+			#elif OOPSY_SDMMC_MHZ >= 25
+			sdconfig.speed           = daisy::SdmmcHandler::Speed::STANDARD;
+			#else
+			sdconfig.speed           = daisy::SdmmcHandler::Speed::MEDIUM_SLOW;
+			#endif
+			#if OOPSY_SDMMC_BUS_WIDTH == 4
+			sdconfig.width           = daisy::SdmmcHandler::BusWidth::BITS_4;
+			#else
 			sdconfig.width           = daisy::SdmmcHandler::BusWidth::BITS_1;
+			#endif
 			handler.Init(sdconfig);
 			fsi.Init(daisy::FatFSInterface::Config::MEDIA_SD);
 			f_mount(&fsi.GetSDFileSystem(), fsi.GetSDPath(), 1);
 		}
 
-		// TODO: resizing without wasting memory
-		int sdcard_load_wav(const char * filename, Data& gendata) {
-			float * buffer = gendata.mData;
-			size_t buffer_frames = gendata.dim;
-			size_t buffer_channels = gendata.channels;
+		// parse a RIFF/WAVE header, leaving the file positioned at the start of the sample data
+		// returns the number of frames in the file, or -1 if it is not a usable wav
+		int sdcard_open_wav(FIL& file, const char * filename, WavFormatChunk& format) {
 			size_t bytesread = 0;
-			WavFormatChunk format;
 			uint32_t header[3];
-			uint32_t marker, frames, chunksize, frames_per_read, frames_to_read, frames_read, total_frames_to_read;
-			uint32_t buffer_index = 0;
+			uint32_t marker, chunksize;
 			size_t bytespersample;
-			if(f_open(&SDFile, filename, (FA_OPEN_EXISTING | FA_READ)) != FR_OK) {
+			if(f_open(&file, filename, (FA_OPEN_EXISTING | FA_READ)) != FR_OK) {
 				log("no %s", filename);
 				return -1;
 			}
-			if (f_eof(&SDFile) 
-				|| f_read(&SDFile, (void *)&header, sizeof(header), &bytesread) != FR_OK
+			if (f_eof(&file) 
+				|| f_read(&file, (void *)&header, sizeof(header), &bytesread) != FR_OK
 				|| header[0] != daisy::kWavFileChunkId 
 				|| header[2] != daisy::kWavFileWaveId) goto badwav;
 			// find the format chunk:
 			do {
-				if (f_eof(&SDFile) || f_read(&SDFile, (void *)&marker, sizeof(marker), &bytesread) != FR_OK) break;
+				if (f_eof(&file) || f_read(&file, (void *)&marker, sizeof(marker), &bytesread) != FR_OK) break;
 			} while (marker != daisy::kWavFileSubChunk1Id);
-			if (f_eof(&SDFile) 
-				|| f_read(&SDFile, (void *)&format, sizeof(format), &bytesread) != FR_OK
+			if (f_eof(&file) 
+				|| f_read(&file, (void *)&format, sizeof(format), &bytesread) != FR_OK
 				|| format.chans == 0 
 				|| format.samplerate == 0 
 				|| format.bitspersample == 0) goto badwav;
 			// find the data chunk:
 			do {
-				if (f_eof(&SDFile) || f_read(&SDFile, (void *)&marker, sizeof(marker), &bytesread) != FR_OK) break;
+				if (f_eof(&file) || f_read(&file, (void *)&marker, sizeof(marker), &bytesread) != FR_OK) break;
 			} while (marker != daisy::kWavFileSubChunk2Id);
 			bytespersample = format.bytesperframe / format.chans;
-			if (f_eof(&SDFile) 
-				|| f_read(&SDFile, (void *)&chunksize, sizeof(chunksize), &bytesread) != FR_OK
+			if (f_eof(&file) 
+				|| f_read(&file, (void *)&chunksize, sizeof(chunksize), &bytesread) != FR_OK
 				|| format.format != 1 
 				|| bytespersample < 2 
 				|| bytespersample > 4) goto badwav; // only 16/24/32-bit PCM, sorry
-			// make sure we read in (multiples of) whole frames
-			frames = chunksize / format.bytesperframe;
-			frames_per_read = OOPSY_WAV_WORKSPACE_BYTES / format.bytesperframe;
-			frames_to_read = frames_per_read;
-			total_frames_to_read = buffer_frames;
-			// log("b=%u c=%u t=%u", buffer_frames, buffer_channels, total_frames_to_read);
-			// log("f=%u c=%u p=%u", frames, format.chans, frames_per_read);
-			// log("bp=%u c=%u p=%u", frames_to_read * format.bytesperframe);
-			do {
-				if (frames_to_read > total_frames_to_read) frames_to_read = total_frames_to_read;
-				f_read(&SDFile, workspace, frames_to_read * format.bytesperframe, &bytesread);
-				frames_read = bytesread / format.bytesperframe;
-				//log("_r=%u t=%u", frames_read, frames_to_read);
-				switch (bytespersample) {
-					case 2:  { // 16 bit
-						for (size_t f=0; f<frames_read; f++) {
-							for (size_t c=0; c<buffer_channels; c++) {
-								uint8_t * frame = workspace + f*format.bytesperframe + (c % format.chans)*bytespersample;
-								buffer[(buffer_index+f)*buffer_channels + c] = ((int16_t *)frame)[0] * 0.000030517578125f;
-							}
-						}
-					} break;
-					case 3: { // 24 bit
-						for (size_t f=0; f<frames_read; f++) {
-							for (size_t c=0; c<buffer_channels; c++) {
-								uint8_t * frame = workspace + f*format.bytesperframe + (c % format.chans)*bytespersample;
-								int32_t b = (int32_t)(
-									((uint32_t)(frame[0]) <<  8) | 
-									((uint32_t)(frame[1]) << 16) | 
-									((uint32_t)(frame[2]) << 24)
-								) >> 8;
-								buffer[(buffer_index+f)*buffer_channels + c] = (float)(((double)b) * 0.00000011920928955078125);
-							}
-						}
-					} break;
-					case 4: { // 32 bit
-						for (size_t f=0; f<frames_read; f++) {
-							for (size_t c=0; c<buffer_channels; c++) {
-								uint8_t * frame = workspace + f*format.bytesperframe + (c % format.chans)*bytespersample;
-								buffer[(buffer_index+f)*buffer_channels + c] = ((int32_t *)frame)[0] / 2147483648.f;
-							}
-						}
-					} break;
-				}
-				total_frames_to_read -= frames_read;
-				buffer_index += frames_read;
-			} while (!f_eof(&SDFile) && bytesread > 0 && total_frames_to_read > 0);
-			f_close(&SDFile);
-			log("read %s", filename);
-			return buffer_index;
+			return chunksize / format.bytesperframe;
 		badwav:
-			f_close(&SDFile);
+			f_close(&file);
 			log("bad %s", filename);
 			return -1;
 		}
+
+		template<int BYTES>
+		static inline float wav_decode(const uint8_t * p) {
+			switch (BYTES) {
+				case 2: return ((const int16_t *)p)[0] * 0.000030517578125f;
+				// 24 bits placed in the top of an int32, which converts to float exactly:
+				case 3: return (int32_t)(
+						((uint32_t)(p[0]) <<  8) | 
+						((uint32_t)(p[1]) << 16) | 
+						((uint32_t)(p[2]) << 24)
+					) * 4.656612873077392578125e-10f;
+				default: return ((const int32_t *)p)[0] * 4.656612873077392578125e-10f;
+			}
+		}
+
+		// the first two cases are also safe when src sits at the tail of dst (see sdcard_load_wav), 
+		// as each frame is read before it is written, and the reads stay ahead of the writes
+		// with a dst_plane, dst is planar: channel c's frames start at dst + c*dst_plane
+		template<int BYTES, typename T>
+		static void wav_convert(const uint8_t * src, size_t src_channels, size_t frames, T * dst, size_t dst_channels, size_t dst_plane) {
+			if (dst_plane && dst_channels > 1) {
+				// de-interleave: one sequential run per channel
+				size_t stride = src_channels*BYTES;
+				for (size_t c=0; c<dst_channels; c++) {
+					const uint8_t * s = src + (c % src_channels)*BYTES;
+					T * d = dst + c*dst_plane;
+					for (size_t f=0; f<frames; f++) d[f] = DataSample<T>::store(wav_decode<BYTES>(s + f*stride));
+				}
+			} else if (src_channels == dst_channels) {
+				// same layout: one straight run of samples
+				size_t n = frames * dst_channels;
+				for (size_t i=0; i<n; i++) dst[i] = DataSample<T>::store(wav_decode<BYTES>(src + i*BYTES));
+			} else if (src_channels == 1) {
+				// mono file: copy to every channel
+				for (size_t f=0; f<frames; f++) {
+					T v = DataSample<T>::store(wav_decode<BYTES>(src + f*BYTES));
+					for (size_t c=0; c<dst_channels; c++) dst[f*dst_channels + c] = v;
+				}
+			} else {
+				// file channels wrap around to fill the data's channels
+				size_t stride = src_channels*BYTES;
+				for (size_t c=0; c<dst_channels; c++) {
+					const uint8_t * s = src + (c % src_channels)*BYTES;
+					T * d = dst + c;
+					for (size_t f=0; f<frames; f++) d[f*dst_channels] = DataSample<T>::store(wav_decode<BYTES>(s + f*stride));
+				}
+			}
+		}
+
+		// convert frames of PCM in src to frames in dst (float, or int16 for a Data16),
+		// interleaved, or planar with each channel dst_plane samples apart
+		template<typename T>
+		void sdcard_convert_wav(const uint8_t * src, const WavFormatChunk& format, size_t frames, T * dst, size_t dst_channels, size_t dst_plane = 0) {
+			switch (format.bytesperframe / format.chans) {
+				case 2: wav_convert<2>(src, format.chans, frames, dst, dst_channels, dst_plane); break;
+				case 3: wav_convert<3>(src, format.chans, frames, dst, dst_channels, dst_plane); break;
+				case 4: wav_convert<4>(src, format.chans, frames, dst, dst_channels, dst_plane); break;
+			}
+		}
+
+		// the SD card DMA writes memory behind the cache's back:
+		// make sure no dirty line over the destination is written back during the transfer,
+		// and that nothing stale is read afterward
+		static void sdcard_dma_begin(void * p, uint32_t bytes) {
+			uintptr_t a = (uintptr_t)p & ~(uintptr_t)(OOPSY_ALLOC_ALIGN-1);
+			SCB_CleanInvalidateDCache_by_Addr((uint32_t *)a, (int32_t)((uintptr_t)p + bytes - a));
+		}
+
+		static void sdcard_dma_end(void * p, uint32_t bytes) {
+			uintptr_t a = (uintptr_t)p & ~(uintptr_t)(OOPSY_ALLOC_ALIGN-1);
+			SCB_InvalidateDCache_by_Addr((uint32_t *)a, (int32_t)((uintptr_t)p + bytes - a));
+		}
+
+		// TODO: resizing without wasting memory
+		template<typename T, bool PLANAR>
+		int sdcard_load_wav(const char * filename, DataInterface<T, PLANAR>& gendata) {
+			T * buffer = gendata.mData;
+			uint32_t buffer_frames = gendata.dim;
+			uint32_t buffer_channels = gendata.channels;
+			// a frame's samples are consecutive unless the data is planar:
+			uint32_t plane = (PLANAR && buffer_channels > 1) ? buffer_frames : 0;
+			uint32_t frame_stride = plane ? 1 : buffer_channels;
+			uint32_t dst_bytesperframe = buffer_channels * sizeof(T);
+			uint32_t frames_per_read;
+			uint32_t frames_read = 0, bytes_read = 0;
+			uint8_t * ws = nullptr;
+			WavFormatChunk format;
+			int file_frames = sdcard_open_wav(SDFile, filename, format);
+			if (file_frames < 0) return -1;
+			uint32_t total_frames = buffer_frames < (uint32_t)file_frames ? buffer_frames : (uint32_t)file_frames;
+			// If the file's frames are no bigger than the converted frames, the PCM can be DMA'd 
+			// straight into the tail of the data's own memory and expanded in place.
+			// Each read covers a multiple of 32 frames, so that the raw and converted spans start on cache lines.
+			frames_per_read = (OOPSY_WAV_LOAD_BYTES / dst_bytesperframe) & ~31u;
+			// (de-interleaving scatters each frame, so it can't be done in place)
+			bool inplace = !plane
+				&& (format.chans == buffer_channels || format.chans == 1) 
+				&& format.bytesperframe <= dst_bytesperframe
+				&& frames_per_read > 0
+				&& !oopsy::arenas[oopsy::REGION_DTCM].contains(buffer); // not reachable by SDMMC DMA
+			if (!inplace) {
+				// otherwise read via a large workspace in SRAM, or the small built-in one if there's no room:
+				ws = (uint8_t *)oopsy::allocate(OOPSY_WAV_LOAD_BYTES, oopsy::REGION_SRAM);
+				frames_per_read = (ws ? OOPSY_WAV_LOAD_BYTES : OOPSY_WAV_WORKSPACE_BYTES) / format.bytesperframe;
+			}
+			uint32_t start = daisy::System::GetUs();
+			while (frames_read < total_frames) {
+				uint32_t frames = total_frames - frames_read;
+				if (frames > frames_per_read) frames = frames_per_read;
+				T * dst = buffer + frames_read*frame_stride;
+				uint32_t bytes = frames * format.bytesperframe;
+				uint8_t * src = inplace ? (uint8_t *)(dst + frames*buffer_channels) - bytes : (ws ? ws : workspace);
+				size_t bytesread = 0;
+				if (inplace) sdcard_dma_begin(src, bytes);
+				FRESULT res = f_read(&SDFile, src, bytes, &bytesread);
+				if (inplace) sdcard_dma_end(src, bytes);
+				if (res != FR_OK) break;
+				// (a short read leaves src further ahead of dst than needed, which is still safe)
+				frames = bytesread / format.bytesperframe;
+				sdcard_convert_wav(src, format, frames, dst, buffer_channels, plane);
+				frames_read += frames;
+				bytes_read += bytesread;
+				if (bytesread < bytes) break;
+			}
+			uint32_t us = daisy::System::GetUs() - start;
+			f_close(&SDFile);
+			if (ws) oopsy::free(ws);
+			if (frames_read == total_frames) oopsy::sample_cache.complete(buffer, frames_read);
+			log_wav_read(filename, bytes_read, us);
+			return frames_read;
+		}
+
+		void log_wav_read(const char * filename, uint32_t bytes, uint32_t us) {
+			// bytes per microsecond is MB/s:
+			uint32_t rate = us ? (uint32_t)(((uint64_t)bytes * 10) / us) : 0;
+			log("read %s", filename);
+			log("%uKB %u.%uMB/s", (unsigned)(bytes/1024), (unsigned)(rate/10), (unsigned)(rate%10));
+		}
+
+		// A wav file queued to load into a [data] in the background,
+		// one chunk per main loop pass, so that the app can start playing right away.
+		// Frames below the `loaded` watermark are ready; frames above it are still silent.
+		struct WavLoad {
+			const void * owner;		// the Data or Data16
+			void * mData;
+			uint32_t dim, channels, samplesize;
+			uint32_t plane;			// samples between channels if planar, else 0
+			const int * modified;
+			const char * filename;
+			WavFormatChunk format;
+			uint32_t frames;		// frames that will be loaded
+			volatile uint32_t loaded; // frames loaded so far
+			uint32_t bytes, start;
+			bool ready;
+			bool direct;			// the file's samples are already in the data's format
+		};
+		WavLoad loads[OOPSY_MAX_WAV_LOADS];
+		int load_count = 0, load_current = 0;
+		bool load_open = false;
+		uint8_t * load_workspace = nullptr;
+
+		template<typename T, bool PLANAR>
+		int sdcard_queue_wav(const char * filename, DataInterface<T, PLANAR>& gendata) {
+			if (load_count >= OOPSY_MAX_WAV_LOADS) {
+				log("too many wavs, reading %s now", filename);
+				return sdcard_load_wav(filename, gendata);
+			}
+			WavLoad& l = loads[load_count++];
+			l.owner = &gendata;
+			l.mData = gendata.mData;
+			l.dim = gendata.dim;
+			l.channels = gendata.channels;
+			l.samplesize = sizeof(T);
+			l.plane = (PLANAR && gendata.channels > 1) ? gendata.dim : 0;
+			l.modified = &gendata.modified;
+			l.filename = filename;
+			l.frames = 0;
+			l.loaded = 0;
+			l.ready = false;
+			l.direct = false;
+			// already in memory from a previous app:
+			oopsy::SampleCache::Entry * cached = oopsy::sample_cache.find(gendata.mData);
+			if (cached && cached->complete) {
+				l.frames = l.loaded = cached->frames;
+				l.ready = true;
+				log("cached %s", filename);
+			}
+			return 0;
+		}
+
+		// the watermark of a queued [data], for gen~ to read as a param
+		uint32_t sdcard_wav_loaded(const void * gendata) {
+			for (int i=0; i<load_count; i++) {
+				if (loads[i].owner == gendata) return loads[i].loaded;
+			}
+			return 0;
+		}
+
+		// call from the main loop
+		void sdcard_load_service() {
+			while (load_current < load_count && loads[load_current].ready) sdcard_load_next();
+			if (load_current >= load_count) return;
+			WavLoad& l = loads[load_current];
+			if (!load_open) {
+				int frames = sdcard_open_wav(SDFile, l.filename, l.format);
+				if (frames < 0) {
+					sdcard_load_next();
+					return;
+				}
+				// The PCM isn't expanded in place here, since the audio callback may be reading the data meanwhile.
+				// But 16-bit PCM is already what a Data16 stores, so it can be DMA'd straight into it:
+				l.direct = l.samplesize == sizeof(int16_t)
+					&& l.format.bytesperframe == l.format.chans * sizeof(int16_t)
+					&& l.format.chans == l.channels
+					&& !l.plane
+					&& ((uintptr_t)l.mData & (OOPSY_ALLOC_ALIGN-1)) == 0
+					&& !oopsy::arenas[oopsy::REGION_DTCM].contains(l.mData); // not reachable by SDMMC DMA
+				// Otherwise it goes via a workspace, which lives in SDRAM to leave SRAM for the app, and is only held while loads are pending:
+				if (!load_workspace && !l.direct) load_workspace = (uint8_t *)oopsy::allocate(OOPSY_WAV_LOAD_BYTES, oopsy::REGION_SDRAM);
+				l.frames = l.dim < (uint32_t)frames ? l.dim : (uint32_t)frames;
+				l.bytes = 0;
+				l.start = daisy::System::GetUs();
+				load_open = true;
+			}
+			uint32_t loaded = l.loaded;
+			uint32_t at = loaded * (l.plane ? 1 : l.channels);
+			// 16 frames of int16 fill whole cache lines (from the line-aligned start of the data), 
+			// so the DMA never shares a line with anything that the audio callback may write meanwhile;
+			// the last few frames go via the workspace:
+			uint32_t direct_frames = ((OOPSY_WAV_LOAD_BYTES / l.format.bytesperframe) < l.frames - loaded 
+				? (OOPSY_WAV_LOAD_BYTES / l.format.bytesperframe) : l.frames - loaded) & ~15u;
+			uint32_t frames, bytes;
+			size_t bytesread = 0;
+			FRESULT res;
+			if (l.direct && direct_frames) {
+				uint8_t * dst = (uint8_t *)((int16_t *)l.mData + at);
+				frames = direct_frames;
+				bytes = frames * l.format.bytesperframe;
+				sdcard_dma_begin(dst, bytes);
+				res = f_read(&SDFile, dst, bytes, &bytesread);
+				sdcard_dma_end(dst, bytes);
+				frames = bytesread / l.format.bytesperframe;
+			} else {
+				uint8_t * ws = load_workspace ? load_workspace : workspace;
+				frames = (load_workspace ? OOPSY_WAV_LOAD_BYTES : OOPSY_WAV_WORKSPACE_BYTES) / l.format.bytesperframe;
+				if (frames > l.frames - loaded) frames = l.frames - loaded;
+				bytes = frames * l.format.bytesperframe;
+				sdcard_dma_begin(ws, bytes);
+				res = f_read(&SDFile, ws, bytes, &bytesread);
+				sdcard_dma_end(ws, bytes);
+				frames = bytesread / l.format.bytesperframe;
+				if (l.samplesize == sizeof(int16_t)) {
+					sdcard_convert_wav(ws, l.format, frames, (int16_t *)l.mData + at, l.channels, l.plane);
+				} else {
+					sdcard_convert_wav(ws, l.format, frames, (t_sample *)l.mData + at, l.channels, l.plane);
+				}
+			}
+			// the frames must be in memory before the audio callback sees the watermark move:
+			__DMB();
+			l.loaded = loaded + frames;
+			l.bytes += bytesread;
+			if (res != FR_OK || bytesread < bytes || l.loaded >= l.frames) {
+				f_close(&SDFile);
+				load_open = false;
+				l.ready = true;
+				if (res == FR_OK) oopsy::sample_cache.complete(l.mData, l.loaded);
+				log_wav_read(l.filename, l.bytes, daisy::System::GetUs() - l.start);
+				sdcard_load_next();
+			}
+		}
+
+		void sdcard_load_next() {
+			load_current++;
+			if (load_current >= load_count && load_workspace) {
+				oopsy::free(load_workspace);
+				#if (OOPSY_APP_SLOTS > 1)
+				if (load_workspace == fade_load_workspace) fade_load_workspace = nullptr;
+				#endif
+				load_workspace = nullptr;
+			}
+		}
+
+		void sdcard_load_cancel() {
+			// a [data] that the app wrote to is no longer a copy of its file:
+			for (int i=0; i<load_count; i++) {
+				if (*loads[i].modified) oopsy::sample_cache.invalidate(loads[i].mData);
+			}
+			if (load_open) f_close(&SDFile);
+			load_open = false;
+			load_count = load_current = 0;
+			// (the workspace is released with the rest of the app's memory)
+			load_workspace = nullptr;
+		}
+
+		// A [data] streamed from a wav file, used as a ring buffer:
+		// audio frame N since the app started playing is at index (N % dim),
+		// and the main loop keeps the frames ahead of the playhead filled from the card.
+		struct WavStream {
+			FIL file;
+			WavFormatChunk format;
+			Data * data;
+			const char * filename;
+			uint8_t * workspace;
+			uint32_t file_frames;	// frames of audio in the file
+			uint32_t file_frame;	// next frame to read from the file
+			uint32_t written;		// frames written into the ring so far
+			volatile uint32_t played; // frames consumed by the audio callback so far
+			volatile uint32_t underruns;
+			uint32_t underruns_reported;
+		};
+		WavStream streams[OOPSY_MAX_WAV_STREAMS];
+		int stream_count = 0;
+
+		int sdcard_stream_wav(const char * filename, Data& gendata) {
+			if (stream_count >= OOPSY_MAX_WAV_STREAMS) {
+				log("too many streams");
+				return -1;
+			}
+			WavStream& s = streams[stream_count];
+			int frames = sdcard_open_wav(s.file, filename, s.format);
+			if (frames < 0) return -1;
+			// the SD driver can DMA straight into a cache-aligned buffer in AXI SRAM:
+			s.workspace = (uint8_t *)oopsy::allocate(OOPSY_WAV_STREAM_CHUNK_BYTES, oopsy::REGION_SRAM);
+			if (!s.workspace || OOPSY_WAV_STREAM_CHUNK_BYTES < s.format.bytesperframe) {
+				f_close(&s.file);
+				log("no memory for %s", filename);
+				return -1;
+			}
+			s.data = &gendata;
+			s.filename = filename;
+			s.file_frames = frames;
+			s.file_frame = 0;
+			s.written = 0;
+			s.played = 0;
+			s.underruns = 0;
+			s.underruns_reported = 0;
+			// prefill the whole ring before the audio callback starts advancing it:
+			while (sdcard_stream_refill(s)) {}
+			__asm__ volatile("" ::: "memory");
+			stream_count++;
+			log("stream %s", filename);
+			return frames;
+		}
+
+		// read one workspace of frames into a stream's ring, if there is room
+		// returns the number of frames written
+		uint32_t sdcard_stream_refill(WavStream& s) {
+			Data& data = *s.data;
+			if (data.dim <= OOPSY_BLOCK_SIZE) return 0;
+			// frames loaded ahead of the playhead; negative once the playhead has overtaken the loading:
+			int32_t ahead = (int32_t)(s.written - s.played);
+			if (ahead < 0) {
+				// the frames behind the playhead are too late to play, 
+				// so skip them (and the block being played now) in both the ring and the file:
+				uint32_t skip = (uint32_t)(-ahead) + OOPSY_BLOCK_SIZE;
+				uint32_t skip_file = s.file_frames - s.file_frame;
+				if (skip_file > skip) skip_file = skip;
+				if (skip_file) {
+					f_lseek(&s.file, f_tell(&s.file) + (FSIZE_t)skip_file * s.format.bytesperframe);
+					s.file_frame += skip_file;
+				}
+				s.written += skip;
+				ahead = (int32_t)OOPSY_BLOCK_SIZE;
+			}
+			// don't overwrite the frames the audio callback may be reading in the current block:
+			int32_t room = (int32_t)(data.dim - OOPSY_BLOCK_SIZE) - ahead;
+			if (room <= 0) return 0;
+			uint32_t space = (uint32_t)room;
+			uint32_t index = s.written % data.dim;
+			uint32_t frames = OOPSY_WAV_STREAM_CHUNK_BYTES / s.format.bytesperframe;
+			if (frames > space) frames = space;
+			// don't wrap around the end of the ring within one read:
+			if (frames > data.dim - index) frames = data.dim - index;
+			float * dst = data.mData + index*data.channels;
+			uint32_t remaining = s.file_frames - s.file_frame;
+			if (remaining > 0) {
+				size_t bytesread = 0;
+				if (frames > remaining) frames = remaining;
+				f_read(&s.file, s.workspace, frames * s.format.bytesperframe, &bytesread);
+				frames = bytesread / s.format.bytesperframe;
+				// a read error ends the stream:
+				if (frames == 0) s.file_frames = s.file_frame;
+				sdcard_convert_wav(s.workspace, s.format, frames, dst, data.channels);
+				s.file_frame += frames;
+			} else {
+				// past the end of the file, the stream plays silence:
+				memset(dst, 0, frames * data.channels * sizeof(float));
+			}
+			s.written += frames;
+			return frames;
+		}
+
+		// call from the main loop
+		void sdcard_stream_service() {
+			for (int i=0; i<stream_count; i++) {
+				WavStream& s = streams[i];
+				sdcard_stream_refill(s);
+				uint32_t underruns = s.underruns;
+				if (underruns != s.underruns_reported) {
+					log("%s underrun x%u", s.filename, (unsigned)(underruns - s.underruns_reported));
+					s.underruns_reported = underruns;
+				}
+			}
+		}
+
+		// call from the audio callback, after the app has read this block
+		void sdcard_stream_advance(size_t size) {
+			int count = stream_count;
+			#if (OOPSY_APP_SLOTS > 1)
+			// (the crossfade callback limits this to the streams of the apps it performed)
+			if (stream_advance_count >= 0) count = stream_advance_count;
+			#endif
+			for (int i=0; i<count; i++) {
+				WavStream& s = streams[i];
+				// the block was played from frames that had not yet been loaded:
+				if ((int32_t)(s.written - s.played) < (int32_t)size) s.underruns = s.underruns + 1;
+				s.played = s.played + size;
+			}
+		}
+
+		void sdcard_stream_close() {
+			for (int i=0; i<stream_count; i++) f_close(&streams[i].file);
+			stream_count = 0;
+		}
+
+		#if (OOPSY_APP_SLOTS > 1)
+		// after a crossfade, stops the outgoing app's loads and streams (the first in each queue), 
+		// leaving the incoming app's
+		void sdcard_fade_release(int loads_out, int streams_out, const uint8_t * workspace_out) {
+			for (int i=0; i<loads_out; i++) {
+				if (*loads[i].modified) oopsy::sample_cache.invalidate(loads[i].mData);
+			}
+			if (load_open && load_current < loads_out) {
+				f_close(&SDFile);
+				load_open = false;
+			}
+			for (int i=loads_out; i<load_count; i++) loads[i - loads_out] = loads[i];
+			load_count -= loads_out;
+			load_current = load_current > loads_out ? load_current - loads_out : 0;
+			// a workspace allocated before the fade goes with the outgoing app's memory:
+			if (load_workspace && load_workspace == workspace_out) load_workspace = nullptr;
+			for (int i=0; i<streams_out; i++) f_close(&streams[i].file);
+			// the audio callback is advancing the same streams, so it mustn't see them half-shifted:
+			__disable_irq();
+			for (int i=streams_out; i<stream_count; i++) streams[i - streams_out] = streams[i];
+			stream_count -= streams_out;
+			__enable_irq();
+		}
 		#endif
+		#endif
+
+		#ifdef OOPSY_USE_SNAPSHOTS
+		// called by an app's init, before it adds its tables and restores
+		void snapshot_begin(size_t (*statesize)(CommonState *), short (*getstate)(CommonState *, char *), short (*setstate)(CommonState *, const char *)) {
+			snapshot_statesize = statesize;
+			snapshot_getstate = getstate;
+			snapshot_setstate = setstate;
+			snapshot_table_count = 0;
+		}
+
+		void snapshot_table(void * data, uint32_t bytes) {
+			if (!data || snapshot_table_count >= OOPSY_SNAPSHOT_TABLES) return;
+			snapshot_tables[snapshot_table_count++] = SnapshotTable{ data, bytes };
+		}
+
+		// each app has its own slot, in whole sectors
+		uint32_t snapshot_slot_bytes() const {
+			return (OOPSY_SNAPSHOT_BYTES / app_count) & ~(uint32_t)(OOPSY_SNAPSHOT_SECTOR-1);
+		}
+
+		uint32_t snapshot_offset() const {
+			return OOPSY_QSPI_SIZE - OOPSY_SNAPSHOT_BYTES + app_selected * snapshot_slot_bytes();
+		}
+
+		uint32_t snapshot_payload_bytes(uint32_t statebytes) const {
+			uint32_t bytes = statebytes;
+			for (int i=0; i<snapshot_table_count; i++) bytes += snapshot_tables[i].bytes;
+			return bytes;
+		}
+
+		uint32_t snapshot_key(uint32_t statebytes) const {
+			const CommonState * cs = (const CommonState *)gen;
+			const char * name = appdefs ? appdefs[app_selected].name : "";
+			uint32_t h = snapshot_hash(OOPSY_SNAPSHOT_MAGIC, name, strlen(name));
+			for (int i=0; i<cs->numparams; i++) h = snapshot_hash(h, cs->params[i].name, strlen(cs->params[i].name));
+			h = snapshot_hash(h, &statebytes, sizeof(statebytes));
+			for (int i=0; i<snapshot_table_count; i++) h = snapshot_hash(h, &snapshot_tables[i].bytes, sizeof(uint32_t));
+			return h;
+		}
+
+		// restores the app's params and tables from its snapshot, if there is a valid one for it
+		// the flash is memory-mapped, so this is only a copy
+		bool snapshot_restore() {
+			if (!snapshot_statesize || !gen) return false;
+			CommonState * cs = (CommonState *)gen;
+			uint32_t statebytes = snapshot_statesize(cs), bytes = snapshot_payload_bytes(statebytes);
+			const SnapshotHeader * h = (const SnapshotHeader *)sub_board->qspi.GetData(snapshot_offset());
+			if (h->magic != OOPSY_SNAPSHOT_MAGIC || h->bytes != bytes || h->key != snapshot_key(statebytes)
+				|| sizeof(SnapshotHeader) + bytes > snapshot_slot_bytes()) return false;
+			const char * payload = (const char *)(h + 1);
+			if (snapshot_hash(OOPSY_SNAPSHOT_MAGIC, payload, bytes) != h->checksum) {
+				log("snapshot corrupt");
+				return false;
+			}
+			snapshot_setstate(cs, payload);
+			payload += statebytes;
+			for (int i=0; i<snapshot_table_count; i++) {
+				memcpy(snapshot_tables[i].data, payload, snapshot_tables[i].bytes);
+				payload += snapshot_tables[i].bytes;
+			}
+			log("snapshot restored");
+			return true;
+		}
+
+		// writes the app's params and tables to its slot; this blocks the main loop while the flash erases (audio runs on)
+		bool snapshot_save() {
+			if (!snapshot_statesize || !gen) return false;
+			CommonState * cs = (CommonState *)gen;
+			uint32_t statebytes = snapshot_statesize(cs), bytes = snapshot_payload_bytes(statebytes);
+			if (statebytes > OOPSY_SNAPSHOT_STATE_BYTES || sizeof(SnapshotHeader) + bytes > snapshot_slot_bytes()) {
+				log("snapshot too big");
+				return false;
+			}
+			char state[OOPSY_SNAPSHOT_STATE_BYTES];
+			snapshot_getstate(cs, state);
+			SnapshotHeader header = { OOPSY_SNAPSHOT_MAGIC, snapshot_key(statebytes), bytes, 0 };
+			header.checksum = snapshot_hash(OOPSY_SNAPSHOT_MAGIC, state, statebytes);
+			for (int i=0; i<snapshot_table_count; i++) {
+				header.checksum = snapshot_hash(header.checksum, snapshot_tables[i].data, snapshot_tables[i].bytes);
+			}
+
+			daisy::QSPIHandle& qspi = sub_board->qspi;
+			uint32_t start = snapshot_offset(), at = start + sizeof(SnapshotHeader);
+			uint32_t end = start + ((sizeof(SnapshotHeader) + bytes + OOPSY_SNAPSHOT_SECTOR-1) & ~(uint32_t)(OOPSY_SNAPSHOT_SECTOR-1));
+			bool ok = qspi.Erase(start, end) == daisy::QSPIHandle::Result::OK;
+			ok = ok && qspi.Write(at, statebytes, (uint8_t *)state) == daisy::QSPIHandle::Result::OK;
+			at += statebytes;
+			for (int i=0; ok && i<snapshot_table_count; i++) {
+				ok = qspi.Write(at, snapshot_tables[i].bytes, (uint8_t *)snapshot_tables[i].data) == daisy::QSPIHandle::Result::OK;
+				at += snapshot_tables[i].bytes;
+			}
+			// the header goes last, so that an interrupted save leaves no valid snapshot:
+			ok = ok && qspi.Write(start, sizeof(SnapshotHeader), (uint8_t *)&header) == daisy::QSPIHandle::Result::OK;
+			// don't let the (memory-mapped) old contents be read from the cache:
+			SCB_InvalidateDCache_by_Addr((uint32_t *)qspi.GetData(start), (int32_t)(end - start));
+			char size[8];
+			format_bytes(size, sizeof(size), sizeof(SnapshotHeader) + bytes);
+			log(ok ? "snapshot saved %s" : "snapshot failed", size);
+			return ok;
+		}
+		#endif // OOPSY_USE_SNAPSHOTS
 
 		template<typename A>
 		void reset(A& newapp) {
 			// first, remove callbacks:
 			mainloopCallback = nullMainloopCallback;
 			displayCallback = nullMainloopCallback;
-			nullAudioCallbackRunning = false;
-			sub_board->ChangeAudioCallback(nullAudioCallback);
-			while (!nullAudioCallbackRunning) daisy::System::Delay(1);
-			// reset memory
-			oopsy::init();
-			// install new app:
-			app = &newapp;
-			newapp.init(*this);
+			#ifdef OOPSY_CONTROL_TASK
+			controlCallback = nullControlCallback;
+			#endif
+			#ifdef OOPSY_USE_SNAPSHOTS
+			snapshot_statesize = nullptr;
+			snapshot_save_scheduled = 0;
+			#endif
+			#if (OOPSY_APP_SLOTS > 1)
+			bool crossfade = app != nullptr;
+			if (crossfade) {
+				// the current app keeps playing while the new one is allocated at the other end of the arenas:
+				// (its loads, streams and cached samples carry on until the fade is done)
+				fade_begin();
+				oopsy::sample_cache.next_app(true);
+				app = &newapp;
+				uint32_t failures = allocate_failures;
+				newapp.init(*this);
+				if (allocate_failures != failures) {
+					// the two apps don't fit side by side, so switch without a crossfade:
+					log("no memory to crossfade");
+					crossfade = false;
+					audio_stop();
+					fade_app = nullptr;
+					// undo the first attempt along with the outgoing app: their loads, streams, cached samples and memory
+					#ifdef OOPSY_TARGET_USES_SDMMC
+					sdcard_load_cancel();
+					sdcard_stream_close();
+					#endif
+					oopsy::sample_cache.abandon();
+					fade_scope.rollback();
+					app_scope.rollback();
+					app_scope.begin();
+					newapp.init(*this);
+				}
+			} else
+			#endif
+			{
+				#ifndef OOPSY_BENCH
+				audio_stop();
+				#endif
+				#ifdef OOPSY_TARGET_USES_SDMMC
+				sdcard_load_cancel();
+				sdcard_stream_close();
+				#endif
+				// release the previous app's memory:
+				app_scope.rollback();
+				oopsy::sample_cache.next_app();
+				// install new app:
+				app = &newapp;
+				newapp.init(*this);
+			}
 			// install new callbacks:
 			mainloopCallback = newapp.staticMainloopCallback;
 			displayCallback = newapp.staticDisplayCallback;
 			#if defined(OOPSY_TARGET_HAS_OLED) && defined(OOPSY_HAS_PARAM_VIEW)
 			paramCallback = newapp.staticParamCallback;
 			#endif
+			#ifdef OOPSY_CONTROL_TASK
+			controlCallback = newapp.staticControlCallback;
+			#endif
 
+			#ifdef OOPSY_USE_PROFILER
+			profiler.init((uint32_t)(SystemCoreClock / sub_board->AudioCallbackRate()));
+			#endif
+			#ifdef OOPSY_BENCH
+			// the bench calls the app's audio callback itself, without the SAI:
+			bench_callback = newapp.staticAudioCallback;
+			#elif (OOPSY_APP_SLOTS > 1)
+			app_perform = newapp.staticPerform;
+			app_callback = newapp.staticAudioCallback;
+			if (crossfade) {
+				// the crossfade callback starts mixing in the new app:
+				__asm__ volatile("" ::: "memory");
+				fade_remaining = OOPSY_CROSSFADE_BLOCKS;
+			} else {
+				sub_board->ChangeAudioCallback(newapp.staticAudioCallback);
+			}
+			#else
 			sub_board->ChangeAudioCallback(newapp.staticAudioCallback);
+			#endif
 			log("gen~ %s", appdefs[app_selected].name);
 			log("SR %dkHz / %dHz", (int)(sub_board->AudioSampleRate()/1000), (int)sub_board->AudioCallbackRate());
-			{
-				log("%d%s/%dKB+%d%s/%dMB", 
-					oopsy::sram_used > 1024 ? oopsy::sram_used/1024 : oopsy::sram_used, 
-					(oopsy::sram_used > 1024 || oopsy::sram_used == 0) ? "" : "B", 
-					OOPSY_SRAM_SIZE/1024, 
-					oopsy::sdram_used > 1048576 ? oopsy::sdram_used/1048576 : oopsy::sdram_used/1024, 
-					(oopsy::sdram_used > 1048576 || oopsy::sdram_used == 0) ? "" : "KB", 
-					OOPSY_SDRAM_SIZE/1048576);
-				// console_display();
-				// hardware.display.Update();
-			}
+			log_memory();
 
 			// reset some state:
 			menu_button_incr = 0;
@@ -432,11 +2348,17 @@ namespace oopsy {
 			hardware.menu_rotate = 0;
 			#endif
 			#ifdef OOPSY_TARGET_USES_MIDI_UART
-			midi_out_writeidx = 0;
-			midi_out_readidx = 0;
+			midi_out_reset();
 			midi_data_idx = 0;
 			midi_in_written = 0;//, midi_out_written = 0;
 			midi_in_active = 0, midi_out_active = 0;
+			#if (OOPSY_APP_SLOTS > 1)
+			// (after a crossfade there was no gap, so anything received since belongs to the new app)
+			if (!crossfade)
+			#endif
+			// drop anything received while the last app was running:
+			midi_in_queue_read = midi_in_queue_write;
+			midi_frames_per_us = sub_board->AudioSampleRate() * 1e-6f;
 			// reset:
 			midi_message1(255);
 			midi_message3(176, 123, 0);
@@ -444,6 +2366,62 @@ namespace oopsy {
 			blockcount = 0;
 		}
 
+		// frees memory that the audio callback may still be reading, once it has run another whole block
+		// (the blocks are released by release_retired() in the main loop)
+		void retire(void * p) { oopsy::retire(p, blockcount); }
+
+		// silences the audio until the next callback is installed
+		void audio_stop() {
+			nullAudioCallbackRunning = false;
+			sub_board->ChangeAudioCallback(nullAudioCallback);
+			while (!nullAudioCallbackRunning) daisy::System::Delay(1);
+		}
+
+		#if (OOPSY_APP_SLOTS > 1)
+		// hands the current app over to the crossfade callback, and opens a scope for the next app in the other app slot
+		void fade_begin() {
+			#ifdef OOPSY_TARGET_USES_SDMMC
+			fade_load_count = load_count;
+			fade_stream_count = stream_count;
+			fade_load_workspace = load_workspace;
+			#endif
+			fade_app = app;
+			fade_gen = gen;
+			fade_perform = app_perform;
+			fade_remaining = -1;
+			__asm__ volatile("" ::: "memory");
+			sub_board->ChangeAudioCallback(crossfadeAudioCallback);
+			fade_scope = app_scope;
+			app_scope.tail = !fade_scope.tail;
+			app_scope.begin();
+			app_slot = 1 - app_slot;
+		}
+
+		// called from the main loop: once the crossfade is done, the outgoing app's memory is released
+		void fade_service() {
+			if (!fade_app || fade_remaining != 0) return;
+			#ifdef OOPSY_TARGET_USES_SDMMC
+			sdcard_fade_release(fade_load_count, fade_stream_count, fade_load_workspace);
+			#endif
+			sub_board->ChangeAudioCallback(app_callback);
+			fade_app = nullptr;
+			oopsy::sample_cache.unpin();
+			fade_scope.rollback();
+		}
+
+		// the apps[] slot that the next app load should construct into
+		int app_load_slot() const { return app ? 1 - app_slot : app_slot; }
+		#endif
+
+		// app loads wait for any crossfade to finish:
+		bool app_loadable() const {
+			#if (OOPSY_APP_SLOTS > 1)
+			return !fade_app;
+			#else
+			return true;
+			#endif
+		}
+
 		#ifdef OOPSY_USE_USB_SERIAL_INPUT
 		static void UsbCallback(uint8_t* buf, uint32_t* len) {
 			memcpy(sumbuff, buf, *len);
@@ -457,9 +2435,12 @@ namespace oopsy {
 			app_count = count;
 			mode = 0;
 
+			oopsy::init();
+
 			#ifdef OOPSY_USE_USB_SERIAL_INPUT
+				// the host enumerates the device in the background, so there is nothing to wait for here
+				// (a line sent before a terminal is open is just dropped):
 				sub_board->usb.Init(daisy::UsbHandle::FS_INTERNAL);
-				daisy::System::Delay(500);
 				sub_board->usb.SetReceiveCallback(UsbCallback, daisy::UsbHandle::FS_INTERNAL);
 			#endif
 
@@ -476,25 +2457,37 @@ namespace oopsy {
 			console_cols = OOPSY_OLED_DISPLAY_WIDTH / font.FontWidth + 1; // +1 to accommodate null terminators.
 			console_rows = OOPSY_OLED_DISPLAY_HEIGHT / font.FontHeight; 
 			console_memory = (char *)calloc(console_cols, console_rows);
+			console_lines = (char **)calloc(console_rows, sizeof(char *));
 			console_stats = (char *)calloc(console_cols, 1);
+			display_rows = (uint32_t *)calloc(console_rows, sizeof(uint32_t));
+			display_blank = (char *)calloc(console_cols, 1);
+			memset(display_blank, ' ', console_cols-1);
+			for (int c=0; c<2; c++) {
+				scope_ring[c] = (float *)oopsy::allocate(OOPSY_SCOPE_RING_FRAMES * sizeof(float), REGION_SDRAM);
+				memset(scope_ring[c], 0, OOPSY_SCOPE_RING_FRAMES * sizeof(float));
+			}
 			for (int i=0; i<console_rows; i++) {
 				console_lines[i] = &console_memory[i*console_cols];
 			}
 			console_line = console_rows-1;
 			#endif
 
+			fpu_flush_to_zero();
 			sub_board->adc.Start();
 			sub_board->StartAudio(nullAudioCallback);
 			mainloopCallback = nullMainloopCallback;
 			displayCallback = nullMainloopCallback;
+			#ifdef OOPSY_CONTROL_TASK
+			controlCallback = nullControlCallback;
+			control_us = daisy::System::GetUs();
+			#endif
 
 			#ifdef OOPSY_TARGET_USES_SDMMC
 			sdcard_init();
 			#endif
 
 			#ifdef OOPSY_TARGET_USES_MIDI_UART
-			midi_out_writeidx = 0;
-			midi_out_readidx = 0;
+			midi_out_reset();
 			midi_data_idx = 0;
 			midi_in_written = 0;//, midi_out_written = 0;
 			midi_in_active = 0, midi_out_active = 0;
@@ -508,13 +2501,16 @@ namespace oopsy {
 			config.pin_config.rx = {DSY_GPIOB, 7};
 			config.pin_config.tx = {DSY_GPIOB, 6};
 			uart.Init(config);
-			uart.StartRx();
+			uart.DmaListenStart(midi_rx_buffer, OOPSY_MIDI_RX_BUFFER_SIZE, midi_rx_callback, this);
 			#endif
 
+			// anything allocated before this point persists across app loads:
+			app_scope.begin();
 			app_selected = 0;
 			appdefs[app_selected].load();
 
 			#ifdef OOPSY_TARGET_HAS_OLED
+			log_service();
 			console_display();
 			#endif 
 
@@ -526,28 +2522,39 @@ namespace oopsy {
 				// pulse seed LED for status according to CPU usage:
 				sub_board->SetLed((t % 1000)/10 <= uint32_t(audioCpuUsage));
 
-				if (app_load_scheduled) {
+				#if (OOPSY_APP_SLOTS > 1)
+				fade_service();
+				#endif
+				release_retired(blockcount);
+				if (app_load_scheduled && app_loadable()) {
 					app_load_scheduled = 0;
 					appdefs[app_selected].load();
 					continue;
 				}
+				#ifdef OOPSY_USE_SNAPSHOTS
+				if (snapshot_save_scheduled) {
+					snapshot_save_scheduled = 0;
+					snapshot_save();
+				}
+				#endif
+
+				#ifdef OOPSY_CONTROL_TASK
+				control_service();
+				#endif
 				
+				#ifdef OOPSY_HAS_LOG
+				log_service();
+				#endif
+
 				// handle app-level code (e.g. for CV/gate outs)
 				mainloopCallback(t, dt);
+				#ifdef OOPSY_TARGET_USES_SDMMC
+				sdcard_stream_service();
+				sdcard_load_service();
+				#endif
 				#ifdef OOPSY_TARGET_USES_MIDI_UART
-				// send data if there's something to read:
-				if (midi_out_readidx != midi_out_writeidx) {
-					uint32_t size = (OOPSY_MIDI_BUFFER_SIZE + midi_out_writeidx - midi_out_readidx) % OOPSY_MIDI_BUFFER_SIZE;
-					size = ((midi_out_readidx + size) <= OOPSY_MIDI_BUFFER_SIZE) ? size : OOPSY_MIDI_BUFFER_SIZE - midi_out_readidx;
-					//for (uint32_t i=0; i<size; i++) log("midi %d", midi_out_data[midi_out_readidx+i]);
-					daisy::UartHandler::Result res = uart.PollTx(midi_out_data + midi_out_readidx, size);
-					if (res == daisy::UartHandler::Result::OK) {
-						midi_out_active = 1;
-						midi_out_readidx = (midi_out_readidx + size) % OOPSY_MIDI_BUFFER_SIZE;
-					} else {
-						log("MIDI transmit err %d", res);
-					}
-				}
+				midi_in_service();
+				midi_out_service();
 				#endif
 				
 				if (uitimer.ready(dt)) {
@@ -558,28 +2565,20 @@ namespace oopsy {
 					if(update && rx_size > 0) {
 						// TODO check bytes for a reset message and jump to bootloader
 						update = false;
-						log(sumbuff);
+						#ifdef OOPSY_USE_PROFILER
+						if (rx_size >= 4 && strncmp(sumbuff, "prof", 4) == 0) {
+							profile_dump();
+						} else
+						#endif
+						#ifdef OOPSY_USE_SNAPSHOTS
+						if (rx_size >= 4 && strncmp(sumbuff, "save", 4) == 0) {
+							snapshot_save_scheduled = 1;
+						} else
+						#endif
+						log("%s", sumbuff);
 					}
 					#endif
 
-					// ST7735 COLOR THEMES - Set different colors for each mode
-                                        #ifdef OOPSY_TARGET_ST7735
-                                        {
-                                                using Driver = daisy::ST7735_4WireSpi128x160Driver;
-                                                switch(mode) {
-                                                        case MODE_MENU:    hardware.display.GetDriver().SetTheme(Driver::COLOR_CYAN, Driver::COLOR_DARKBLUE, Driver::COLOR_MAGENTA); break;
-                                                        case MODE_PARAMS:  hardware.display.GetDriver().SetTheme(Driver::COLOR_GREEN, Driver::COLOR_BLACK, Driver::COLOR_LIME); break;
-                                                        case MODE_SCOPE:   hardware.display.GetDriver().SetTheme(Driver::COLOR_ORANGE, Driver::COLOR_PURPLE, Driver::COLOR_YELLOW); break;
-                                                        case MODE_CONSOLE: hardware.display.GetDriver().SetTheme(Driver::COLOR_MAGENTA, Driver::COLOR_BLACK, Driver::COLOR_CYAN); break;
-                                                        default:           hardware.display.GetDriver().SetTheme(Driver::COLOR_WHITE, Driver::COLOR_BLACK, Driver::COLOR_CYAN); break;
-                                                }
-                                        }
-                                        #endif
-
-                                        // CLEAR DISPLAY
-					#ifdef OOPSY_TARGET_HAS_OLED
-					hardware.display.Fill(false);
-					#endif
 					#ifdef OOPSY_TARGET_PETAL 
 					hardware.ClearLeds();
 					#endif
@@ -689,19 +2688,34 @@ namespace oopsy {
 						#if defined (OOPSY_HAS_PARAM_VIEW) && defined(OOPSY_CAN_PARAM_TWEAK)
 						} else if (mode == MODE_PARAMS) {
 							param_is_tweaking = !param_is_tweaking;
+							#ifdef OOPSY_USE_SNAPSHOTS
+							// a tweak is kept once it is done:
+							if (!param_is_tweaking) snapshot_save_scheduled = 1;
+							#endif
 						#endif //OOPSY_HAS_PARAM_VIEW && OOPSY_CAN_PARAM_TWEAK
+						#ifdef OOPSY_USE_PROFILER
+						} else if (mode == MODE_PROFILE) {
+							profiler.reset_requested = true;
+						#endif //OOPSY_USE_PROFILER
 						#endif //OOPSY_TARGET_HAS_OLED
 						}
 					} 
 
 					// OLED DISPLAY:
 					#ifdef OOPSY_TARGET_HAS_OLED
+					// the scope is redrawn every frame; other modes only when they change, or the mode does:
+					if (mode != display_mode || is_mode_selecting != display_selecting || mode == MODE_SCOPE) {
+						display_invalidate();
+					}
 					int showstats = 0;
 					switch(mode) {
 						#ifdef OOPSY_MULTI_APP
 						case MODE_MENU: {
 							showstats = 1;
 							for (int i=0; i<console_rows; i++) {
+								uint32_t hash = display_hash(display_hash(OOPSY_DISPLAY_HASH, (i == app_selecting) | (i == app_selected) << 1), 
+									i < app_count ? appdefs[i].name : "");
+								if (!display_row_changed(i, hash)) continue;
 								if (i == app_selecting) {
 									hardware.display.SetCursor(0, font.FontHeight * i);
 									hardware.display.WriteString((char *)">", font, true);
@@ -720,10 +2734,14 @@ namespace oopsy {
 							if (param_scroll > param_selected) param_scroll = param_selected;
 							if (param_scroll < (param_selected - console_rows + 1)) param_scroll = (param_selected - console_rows + 1);
 							int idx = param_scroll; // offset this for screen-scroll
-							for (int line=0; line<console_rows && idx < param_count; line++, idx++) {
-								paramCallback(idx, label, console_cols, param_is_tweaking && idx == param_selected);
-								hardware.display.SetCursor(0, font.FontHeight * line);
-								hardware.display.WriteString(label, font, (param_selected != idx));	
+							for (int line=0; line<console_rows; line++, idx++) {
+								if (idx < param_count) {
+									// (always called, as it also applies encoder tweaks)
+									paramCallback(idx, label, console_cols, param_is_tweaking && idx == param_selected);
+								} else {
+									label[0] = 0;
+								}
+								display_text_row(line, label, (param_selected != idx));
 							}
 						} break;
 						#endif // OOPSY_HAS_PARAM_VIEW
@@ -733,7 +2751,7 @@ namespace oopsy {
 							uint8_t w2 = OOPSY_OLED_DISPLAY_WIDTH/2, w4 = OOPSY_OLED_DISPLAY_WIDTH/4;
 							uint8_t h2 = h/2, h4 = h/4;
 							size_t zoomlevel = scope_samples();
-							hardware.display.Fill(false);
+							scope_decimate();
 
 							// stereo views:
 							switch (scope_style) {
@@ -825,41 +2843,154 @@ namespace oopsy {
 							console_display(); 
 							break;
 						}
+						#ifdef OOPSY_USE_PROFILER
+						case MODE_PROFILE: 
+						{
+							profile_display();
+							break;
+						}
+						#endif
 						default: {
 						}
-					}
-					if (is_mode_selecting) {
-						hardware.display.DrawRect(0, 0, OOPSY_OLED_DISPLAY_WIDTH-1, OOPSY_OLED_DISPLAY_HEIGHT-1, 1);
-					} 
-					if (showstats) {
-						int offset = 0;
-						#ifdef OOPSY_TARGET_USES_MIDI_UART
-						offset += snprintf(console_stats+offset, console_cols-offset, "%c%c", midi_in_active ? '<' : ' ', midi_out_active ? '>' : ' ');
-						midi_in_active = midi_out_active = 0;
+					}
+					if (showstats) {
+						int offset = 0;
+						#ifdef OOPSY_TARGET_USES_MIDI_UART
+						offset += snprintf(console_stats+offset, console_cols-offset, "%c%c", midi_in_active ? '<' : ' ', midi_out_active ? '>' : ' ');
+						midi_in_active = midi_out_active = 0;
+						#endif
+						offset += snprintf(console_stats+offset, console_cols-offset, "%02d%%", int(audioCpuUsage));
+						// a redrawn top row covers the stats, and shorter stats leave the top row to be redrawn next frame:
+						uint32_t hash = display_hash(OOPSY_DISPLAY_HASH, console_stats);
+						if (hash != display_stats_hash) {
+							if (offset < display_stats_len) display_rows[0] = 0;
+							display_stats_hash = hash;
+							display_stats_len = offset;
+							hardware.display.SetCursor(OOPSY_OLED_DISPLAY_WIDTH - (offset) * font.FontWidth, font.FontHeight * 0);
+							hardware.display.WriteString(console_stats, font, true);
+							display_dirty = true;
+						}
+					}
+					// text rows overwrite the frame's edges:
+					if (is_mode_selecting && display_dirty) {
+						hardware.display.DrawRect(0, 0, OOPSY_OLED_DISPLAY_WIDTH-1, OOPSY_OLED_DISPLAY_HEIGHT-1, 1);
+					} 
+					#endif //OOPSY_TARGET_HAS_OLED
+					menu_button_incr = 0;
+					
+					// handle app-level code (e.g. for LED etc.)
+					displayCallback(t, dt);
+
+					#ifdef OOPSY_TARGET_HAS_OLED
+					display_update();
+					#endif //OOPSY_TARGET_HAS_OLED
+
+					#if (OOPSY_TARGET_PETAL)
+					hardware.UpdateLeds();
+					#endif //(OOPSY_TARGET_PETAL)
+				} // uitimer.ready
+				
+			}
+			return 0;
+		}
+
+		#ifdef OOPSY_BENCH
+		daisy::AudioHandle::AudioCallback bench_callback = nullptr;
+		uint32_t bench_seed = 1;
+		float bench_ins[OOPSY_IO_COUNT][OOPSY_BLOCK_SIZE];
+		float bench_outs[OOPSY_IO_COUNT][OOPSY_BLOCK_SIZE];
+
+		// instead of run(): times each app at each block size over deterministic input (noise, with an impulse at the start),
+		// without the UI or the audio interrupt, and prints the results over USB serial
+		int bench(AppDef * appdefs, int count, const int * blocks, int block_count) {
+			this->appdefs = appdefs;
+			app_count = count;
+			mode = 0;
+
+			oopsy::init();
+			cycle_counter_start();
+			// the bench calls the audio callback from the main loop, so it measures the FPSCR modes set here:
+			fpu_flush_to_zero();
+			// wait for a serial terminal, so that nothing is missed:
+			sub_board->StartLog(true);
+
+			sub_board->adc.Start();
+			mainloopCallback = nullMainloopCallback;
+			displayCallback = nullMainloopCallback;
+			#ifdef OOPSY_CONTROL_TASK
+			controlCallback = nullControlCallback;
+			#endif
+			#ifdef OOPSY_TARGET_USES_SDMMC
+			sdcard_init();
+			#endif
+
+			// anything allocated before this point persists across app loads:
+			app_scope.begin();
+
+			const float * ins[OOPSY_IO_COUNT];
+			float * outs[OOPSY_IO_COUNT];
+			for (int i=0; i<OOPSY_IO_COUNT; i++) {
+				ins[i] = bench_ins[i];
+				outs[i] = bench_outs[i];
+			}
+			float samplerate = sub_board->AudioSampleRate();
+			sub_board->PrintLine("oopsy bench: %d apps, %dHz, %uMHz, %ds per block size", 
+				count, (int)samplerate, (unsigned)(SystemCoreClock/1000000), OOPSY_BENCH_SECONDS);
+			sub_board->PrintLine("app block cycles/sample worst(%%) dtcm sram sdram");
+			for (int app=0; app<count; app++) {
+				for (int b=0; b<block_count; b++) {
+					size_t size = blocks[b];
+					sub_board->SetAudioBlockSize(size);
+					app_selected = app_selecting = app;
+					appdefs[app].load();
+
+					// the main loop runs between blocks (for background wav loads etc.), but isn't timed:
+					uint32_t callbacks = (uint32_t)(OOPSY_BENCH_SECONDS * samplerate / size);
+					uint64_t total = 0;
+					uint32_t worst = 0;
+					for (uint32_t n=0; n<callbacks; n++) {
+						for (int c=0; c<OOPSY_IO_COUNT; c++) {
+							for (size_t i=0; i<size; i++) {
+								bench_seed = bench_seed * 1664525u + 1013904223u;
+								bench_ins[c][i] = (int32_t)bench_seed * (0.25f/2147483648.f);
+							}
+							if (n == 0) bench_ins[c][0] = 1.f;
+						}
+						uint32_t start = cycle_count();
+						bench_callback(ins, outs, size);
+						uint32_t cycles = cycle_count() - start;
+						total += cycles;
+						if (cycles > worst) worst = cycles;
+						mainloopCallback(daisy::System::GetNow(), 1);
+						#ifdef OOPSY_CONTROL_TASK
+						control_scan();
+						controlCallback();
+						#endif
+						#ifdef OOPSY_TARGET_USES_SDMMC
+						sdcard_stream_service();
+						sdcard_load_service();
 						#endif
-						offset += snprintf(console_stats+offset, console_cols-offset, "%02d%%", int(audioCpuUsage));
-						// stats:
-						hardware.display.SetCursor(OOPSY_OLED_DISPLAY_WIDTH - (offset) * font.FontWidth, font.FontHeight * 0);
-						hardware.display.WriteString(console_stats, font, true);
 					}
-					#endif //OOPSY_TARGET_HAS_OLED
-					menu_button_incr = 0;
-					
-					// handle app-level code (e.g. for LED etc.)
-					displayCallback(t, dt);
-
-					#ifdef OOPSY_TARGET_HAS_OLED
-					hardware.display.Update();
-					#endif //OOPSY_TARGET_HAS_OLED
 
-					#if (OOPSY_TARGET_PETAL)
-					hardware.UpdateLeds();
-					#endif //(OOPSY_TARGET_PETAL)
-				} // uitimer.ready
-				
+					// per-sample cost in hundredths of a cycle, and the worst block against its real-time budget:
+					uint32_t per_sample = callbacks ? (uint32_t)((total * 100) / ((uint64_t)callbacks * size)) : 0;
+					uint32_t budget = (uint32_t)(SystemCoreClock * (uint64_t)size / samplerate);
+					uint32_t worst_percent = budget ? (uint32_t)(((uint64_t)worst * 100) / budget) : 0;
+					char region_used[REGION_COUNT][8];
+					for (int i=0; i<REGION_COUNT; i++) format_bytes(region_used[i], sizeof(region_used[i]), arenas[i].highwater);
+					sub_board->PrintLine("%s %u %u.%02u %u(%u%%) %s %s %s", 
+						appdefs[app].name, (unsigned)size, (unsigned)(per_sample/100), (unsigned)(per_sample%100), 
+						(unsigned)worst, (unsigned)worst_percent,
+						region_used[REGION_DTCM], region_used[REGION_SRAM], region_used[REGION_SDRAM]);
+				}
+			}
+			sub_board->PrintLine("oopsy bench done");
+			while (1) {
+				sub_board->SetLed((daisy::System::GetNow() % 1000) < 500);
 			}
 			return 0;
 		}
+		#endif // OOPSY_BENCH
 
 		void schedule_app_load(int which) {
 			app_selected = app_selecting = which % app_count;
@@ -868,12 +2999,23 @@ namespace oopsy {
 
 		void audio_preperform(size_t size) {
 			#ifdef OOPSY_TARGET_USES_MIDI_UART
-			// fill remainder of midi buffer with non-data:
-			for (size_t i=midi_in_written; i<size; i++) midi_in_data[i] = -0.1f;
-			// done with midi input:
+			// advance the sample clock; bytes queued during the last block are delivered against its start:
+			midi_in_block_frame = midi_clock;
+			midi_clock = midi_in_block_frame + size;
+			midi_clock_us = daisy::System::GetUs();
+			midi_block_size = size;
+			// non-data, until the app writes bytes at their offsets:
+			for (size_t i=0; i<size; i++) midi_in_data[i] = -0.1f;
 			midi_in_written = 0;
 			#endif
 
+			#ifndef OOPSY_CONTROL_TASK
+			control_scan();
+			#endif
+		}
+
+		// reads the ADC, encoders, switches and gates, and the menu controls derived from them
+		void control_scan() {
 			hardware.ProcessAllControls();
 
 			#if defined(OOPSY_TARGET_SEED)
@@ -898,9 +3040,51 @@ namespace oopsy {
 			#endif
 		}
 
+		#ifdef OOPSY_CONTROL_TASK
+		// called from the main loop: scans the controls at OOPSY_CONTROL_RATE, 
+		// and has the app publish a new snapshot for the audio callback
+		void control_service() {
+			uint32_t us = daisy::System::GetUs();
+			if (us - control_us < OOPSY_CONTROL_PERIOD_US) return;
+			// if the main loop stalled (e.g. a display update), resync rather than scanning in a burst:
+			control_us = (us - control_us >= 2*OOPSY_CONTROL_PERIOD_US) ? us : control_us + OOPSY_CONTROL_PERIOD_US;
+			control_scan();
+			controlCallback();
+		}
+		#endif
+
+		// everything after the app's audio callback: the scope etc., and the CPU usage
+		void audio_epilogue(daisy::AudioHandle::InputBuffer hardware_ins, daisy::AudioHandle::OutputBuffer hardware_outs, size_t size, uint32_t start) {
+			#ifdef OOPSY_USE_PROFILER
+			profiler.lap(PROFILE_EPILOGUE);
+			#endif
+			#if (OOPSY_IO_COUNT == 4)
+			float * buffers[] = {
+				(float *)hardware_ins[0], (float *)hardware_ins[1], (float *)hardware_ins[2], (float *)hardware_ins[3], 
+				hardware_outs[0], hardware_outs[1], hardware_outs[2], hardware_outs[3]};
+			#else
+			float * buffers[] = {(float *)hardware_ins[0], (float *)hardware_ins[1], hardware_outs[0], hardware_outs[1]};
+			#endif
+			audio_postperform(buffers, size);
+			#ifdef OOPSY_USE_PROFILER
+			profiler.lap(PROFILE_POST);
+			profiler.end();
+			#endif
+			// convert elapsed time (us) to CPU percentage (0-100) of available processing time
+			// 100 (%) * (0.000001 * used_us) * callbackrateHz
+			float percent = (daisy::System::GetUs() - start)*0.0001f*sub_board->AudioCallbackRate();
+			percent = percent > 100.f ? 100.f : percent;
+			// with a falling-only slew to capture spikes, since we care most about worst-case performance
+			audioCpuUsage = (percent > audioCpuUsage) ? percent 
+				: audioCpuUsage + 0.02f*(percent - audioCpuUsage);
+		}
+
 		void audio_postperform(float **buffers, size_t size) {
+			#ifdef OOPSY_TARGET_USES_SDMMC
+			sdcard_stream_advance(size);
+			#endif
 			#ifdef OOPSY_TARGET_HAS_OLED
-			if (mode == MODE_SCOPE) {
+			if (scope_ring[0]) {
 				// selector for scope storage source:
 				// e.g. for OOPSY_IO_COUNT=4, inputs:outputs as 0123:4567 makes:
 				// 01, 23, 45, 67  2n:2n+1  i1i2 i3i4 o1o2 o3o4
@@ -909,120 +3093,452 @@ namespace oopsy {
 				float * buf0 = (scope_source < OOPSY_IO_COUNT) ? buffers[2*n  ] : buffers[n   ]; 
 				float * buf1 = (scope_source < OOPSY_IO_COUNT) ? buffers[2*n+1] : buffers[n+OOPSY_IO_COUNT];
 
-				// float * buf0 = scope_source ? buffers[0] : buffers[2];
-				// float * buf1 = scope_source ? buffers[1] : buffers[3];
-				size_t samples = scope_samples();
-				if (samples > size) samples=size;
-
-				for (size_t i=0; i<size/samples; i++) {
-					float min0 = 10.f, max0 = -10.f;
-					float min1 = 10.f, max1 = -10.f;
-					for (size_t j=0; j<samples; j++) {
-						float pt0 = *buf0++;
-						float pt1 = *buf1++;
-						min0 = min0 > pt0 ? pt0 : min0;
-						max0 = max0 < pt0 ? pt0 : max0;
-						min1 = min1 > pt1 ? pt1 : min1;
-						max1 = max1 < pt1 ? pt1 : max1;
-					}
-					scope_data[scope_step][0] = (min0);
-					scope_data[scope_step][1] = (min1);
-					scope_step++;
-					scope_data[scope_step][0] = (max0); 
-					scope_data[scope_step][1] = (max1);
-					scope_step++;
-					if (scope_step >= OOPSY_OLED_DISPLAY_WIDTH*2) scope_step = 0;
+				// only a copy, whatever page is showing; scope_decimate() does the rest in the main loop:
+				uint32_t w = scope_ring_write;
+				uint32_t at = w & (OOPSY_SCOPE_RING_FRAMES-1);
+				uint32_t first = (at + size <= OOPSY_SCOPE_RING_FRAMES) ? size : OOPSY_SCOPE_RING_FRAMES - at;
+				#ifdef GENLIB_USE_ARMMATH
+				arm_copy_f32(buf0, scope_ring[0] + at, first);
+				arm_copy_f32(buf1, scope_ring[1] + at, first);
+				if (first < size) {
+					arm_copy_f32(buf0 + first, scope_ring[0], size - first);
+					arm_copy_f32(buf1 + first, scope_ring[1], size - first);
+				}
+				#else
+				memcpy(scope_ring[0] + at, buf0, first * sizeof(float));
+				memcpy(scope_ring[1] + at, buf1, first * sizeof(float));
+				if (first < size) {
+					memcpy(scope_ring[0], buf0 + first, (size - first) * sizeof(float));
+					memcpy(scope_ring[1], buf1 + first, (size - first) * sizeof(float));
 				}
+				#endif
+				__asm__ volatile("" ::: "memory");
+				scope_ring_write = w + size;
 			}
 			#endif
 			blockcount++;
 		}
 
 		#ifdef OOPSY_TARGET_HAS_OLED
+		// samples per pixel at each zoom
 		inline int scope_samples() {
-			// valid zoom sizes: 1, 2, 3, 4, 6, 8, 12, 16, 24
-			switch(scope_zoom) {
-				case 1: case 2: case 3: case 4: return scope_zoom; break;
-				case 5: return 6; break;
-				case 6: return 12; break;
-				case 7: return 16; break;
-				default: return 24; break;
+			static const uint8_t zooms[OOPSY_SCOPE_MAX_ZOOM] = { 1, 2, 3, 4, 6, 12, 16, 24, 48, 96, 192 };
+			return zooms[scope_zoom % OOPSY_SCOPE_MAX_ZOOM];
+		}
+
+		// the min & max of each pixel's span of the latest samples in the ring, ending at the most recent block
+		void scope_decimate() {
+			static_assert(OOPSY_OLED_DISPLAY_WIDTH * 192 + 4096 <= OOPSY_SCOPE_RING_FRAMES, "OOPSY_SCOPE_RING_FRAMES is too small for the display width");
+			const uint32_t mask = OOPSY_SCOPE_RING_FRAMES-1;
+			uint32_t zoom = scope_samples();
+			uint32_t idx = scope_ring_write - OOPSY_OLED_DISPLAY_WIDTH * zoom;
+			for (int i=0; i<OOPSY_OLED_DISPLAY_WIDTH; i++) {
+				for (int c=0; c<2; c++) {
+					const float * ring = scope_ring[c];
+					float lo = 10.f, hi = -10.f;
+					for (uint32_t j=0; j<zoom; j++) {
+						float pt = ring[(idx + j) & mask];
+						lo = lo > pt ? pt : lo;
+						hi = hi < pt ? pt : hi;
+					}
+					scope_data[i*2  ][c] = lo;
+					scope_data[i*2+1][c] = hi;
+				}
+				idx += zoom;
+			}
+		}
+
+		static uint32_t display_hash(uint32_t h, const char * s) {
+			while (*s) h = (h ^ (uint8_t)*s++) * 16777619u;
+			return h;
+		}
+
+		static uint32_t display_hash(uint32_t h, int v) {
+			return (h ^ (uint32_t)v) * 16777619u;
+		}
+
+		// clears the screen, and forgets what was on it, e.g. on a change of mode
+		void display_invalidate() {
+			// ST7735 COLOR THEMES - Set different colors for each mode
+			#ifdef OOPSY_TARGET_ST7735
+			if (mode != display_mode) {
+				using Driver = daisy::ST7735_4WireSpi128x160Driver;
+				switch(mode) {
+					case MODE_MENU:    hardware.display.GetDriver().SetTheme(Driver::COLOR_CYAN, Driver::COLOR_DARKBLUE, Driver::COLOR_MAGENTA); break;
+					case MODE_PARAMS:  hardware.display.GetDriver().SetTheme(Driver::COLOR_GREEN, Driver::COLOR_BLACK, Driver::COLOR_LIME); break;
+					case MODE_SCOPE:   hardware.display.GetDriver().SetTheme(Driver::COLOR_ORANGE, Driver::COLOR_PURPLE, Driver::COLOR_YELLOW); break;
+					case MODE_CONSOLE: hardware.display.GetDriver().SetTheme(Driver::COLOR_MAGENTA, Driver::COLOR_BLACK, Driver::COLOR_CYAN); break;
+					default:           hardware.display.GetDriver().SetTheme(Driver::COLOR_WHITE, Driver::COLOR_BLACK, Driver::COLOR_CYAN); break;
+				}
+			}
+			#endif
+			hardware.display.Fill(false);
+			for (int i=0; i<console_rows; i++) display_rows[i] = 0;
+			display_stats_hash = 0;
+			display_mode = mode;
+			display_selecting = is_mode_selecting;
+			display_dirty = true;
+		}
+
+		// returns true (and blanks the row, ready to be drawn) if the row's content hash differs from what is on screen
+		bool display_row_changed(int row, uint32_t hash) {
+			if (display_rows[row] == hash) return false;
+			display_rows[row] = hash;
+			hardware.display.SetCursor(0, font.FontHeight * row);
+			hardware.display.WriteString(display_blank, font, true);
+			// the stats corner sits on the top row:
+			if (row == 0) display_stats_hash = 0;
+			display_dirty = true;
+			return true;
+		}
+
+		void display_text_row(int row, const char * text, bool on=true) {
+			if (display_row_changed(row, display_hash(display_hash(OOPSY_DISPLAY_HASH, on), text))) {
+				hardware.display.SetCursor(0, font.FontHeight * row);
+				hardware.display.WriteString((char *)text, font, on);
+			}
+		}
+
+		// sends the frame only if something was drawn.
+		// the transfer blocks, so MIDI is serviced either side of it
+		void display_update() {
+			if (!display_dirty) return;
+			#ifdef OOPSY_TARGET_USES_MIDI_UART
+			midi_in_service();
+			midi_out_service();
+			#endif
+			hardware.display.Update();
+			display_dirty = false;
+			#ifdef OOPSY_TARGET_USES_MIDI_UART
+			midi_in_service();
+			midi_out_service();
+			#endif
+		}
+
+		#ifdef OOPSY_USE_PROFILER
+		// per-stage min/avg/max as a percentage of the block budget, the callback histogram and xruns
+		// a short press resets the stats
+		GenDaisy& profile_display() {
+			char line[console_cols];
+			int row = 0;
+			snprintf(line, console_cols, "%%     min   avg   max");
+			display_text_row(row++, line);
+			for (int i=0; i<PROFILE_COUNT && row<console_rows; i++) {
+				const Profiler::Stats& st = profiler.stats[i];
+				if (st.count) {
+					unsigned lo = profiler.permille(st.min), mid = profiler.permille(st.avg()), hi = profiler.permille(st.max);
+					snprintf(line, console_cols, "%-3s%4u.%u%4u.%u%4u.%u", 
+						Profiler::name(i), lo/10, lo%10, mid/10, mid%10, hi/10, hi%10);
+				} else {
+					snprintf(line, console_cols, "%-3s     -", Profiler::name(i));
+				}
+				display_text_row(row++, line);
+			}
+			if (row < console_rows) {
+				profiler.format_histogram(line, console_cols, PROFILE_TOTAL);
+				display_text_row(row++, line);
+			}
+			if (row < console_rows) {
+				#ifdef OOPSY_IDLE_HOLD_MS
+				snprintf(line, console_cols, "xrun %u idle %u%%", (unsigned)profiler.xruns, 
+					(unsigned)(profiler.stats[PROFILE_TOTAL].count ? ((uint64_t)profiler.idle * 100) / profiler.stats[PROFILE_TOTAL].count : 0));
+				#else
+				snprintf(line, console_cols, "xrun %u", (unsigned)profiler.xruns);
+				#endif
+				display_text_row(row++, line);
 			}
+			return *this;
 		}
+		#endif // OOPSY_USE_PROFILER
 
 		GenDaisy& console_display() {
 			for (int i=0; i<console_rows; i++) {
-				hardware.display.SetCursor(0, font.FontHeight * i);
-				hardware.display.WriteString(console_lines[(i+console_line) % console_rows], font, true);
+				display_text_row(i, console_lines[(i+console_line) % console_rows]);
 			}
 			return *this;
 		}
 		#endif // OOPSY_TARGET_HAS_OLED
 
-		GenDaisy& log(const char * fmt, ...) {
-			#ifdef OOPSY_TARGET_HAS_OLED
-			va_list argptr;
-			va_start(argptr, fmt);
-			vsnprintf(console_lines[console_line], console_cols, fmt, argptr);
-			va_end(argptr);
-			console_line = (console_line + 1) % console_rows;
+		// one line per region: used/size and the high-water mark since the app was loaded
+		void log_memory() {
+			for (int i=0; i<REGION_COUNT; i++) {
+				const Arena& a = arenas[i];
+				char used[8], size[8], peak[8];
+				format_bytes(used, sizeof(used), a.in_use());
+				format_bytes(size, sizeof(size), a.size);
+				format_bytes(peak, sizeof(peak), a.highwater);
+				log("%s %s/%s ^%s", a.name, used, size, peak);
+			}
+			if (sample_cache.size) {
+				char used[8], size[8];
+				format_bytes(used, sizeof(used), sample_cache.used);
+				format_bytes(size, sizeof(size), sample_cache.size);
+				log("cache %s/%s", used, size);
+			}
+		}
+
+		#if defined(OOPSY_USE_PROFILER) && defined(OOPSY_USE_USB_SERIAL_INPUT)
+		// sends the profile over USB serial (in response to "prof"), in cycles
+		void profile_dump() {
+			// the USB stack sends from the buffer after TransmitInternal returns, so it mustn't be on the stack:
+			static char line[128];
+			int len = snprintf(line, sizeof(line), "budget %u cycles/block, xruns %u, idle %u\r\n", (unsigned)profiler.budget, (unsigned)profiler.xruns, (unsigned)profiler.idle);
+			sub_board->usb.TransmitInternal((uint8_t *)line, len);
+			for (int i=0; i<PROFILE_COUNT; i++) {
+				// the USB stack can refuse a packet while the previous one is in flight, and is still reading the buffer:
+				daisy::System::Delay(2);
+				const Profiler::Stats& st = profiler.stats[i];
+				len = snprintf(line, sizeof(line), "%s min %u avg %u max %u n %u |", Profiler::name(i), 
+					(unsigned)(st.count ? st.min : 0), (unsigned)st.avg(), (unsigned)st.max, (unsigned)st.count);
+				for (int b=0; b<OOPSY_PROFILE_BINS && len < (int)sizeof(line); b++) {
+					len += snprintf(line+len, sizeof(line)-len, " %u", (unsigned)st.bins[b]);
+				}
+				if (len < (int)sizeof(line)-2) len += snprintf(line+len, sizeof(line)-len, "\r\n");
+				sub_board->usb.TransmitInternal((uint8_t *)line, len);
+			}
+		}
+		#endif
+
+		// queues a message to show on the console (and with OOPSY_LOG_SERIAL, to send over USB serial).
+		// it is only formatted later, in the main loop, so it is safe and cheap to call from the audio callback.
+		// fmt must outlive the message (e.g. be a literal); any string arguments are copied
+		template<typename... Args>
+		GenDaisy& log(const char * fmt, Args... args) {
+			#ifdef OOPSY_HAS_LOG
+			LogEntry * entry = log_ring.reserve();
+			if (entry) {
+				entry->fmt = fmt;
+				entry->format = log_format<Args...>;
+				uint8_t * p = entry->args;
+				const uint8_t * end = entry->args + OOPSY_LOG_ARG_BYTES;
+				entry->truncated = false;
+				int unpacked[] = { 0, (p = LogArg<Args>::pack(p, end, args, entry->truncated), 0)... };
+				(void)unpacked;
+				log_ring.publish(entry);
+			}
 			#endif
 			return *this;
 		}
 
+		#ifdef OOPSY_HAS_LOG
+		// called from the main loop: formats the queued messages onto the console (and/or USB serial)
+		void log_service() {
+			char line[OOPSY_LOG_LINE];
+			while (const LogEntry * entry = log_ring.front()) {
+				entry->format(line, sizeof(line), *entry);
+				// marks a message whose arguments didn't all fit in OOPSY_LOG_ARG_BYTES:
+				if (entry->truncated) {
+					size_t n = strlen(line);
+					if (n < sizeof(line) - 1) { line[n] = '~'; line[n+1] = 0; }
+				}
+				log_line(line);
+				log_ring.pop();
+			}
+			// messages are only dropped once the ring is full, so they came after all of those in it:
+			uint32_t dropped = log_ring.dropped;
+			if (dropped != log_dropped) {
+				snprintf(line, sizeof(line), "log dropped x%u", (unsigned)(dropped - log_dropped));
+				log_dropped = dropped;
+				log_line(line);
+			}
+			#ifdef OOPSY_LOG_SERIAL
+			if (log_serial_dropped != log_serial_reported) {
+				snprintf(line, sizeof(line), "serial dropped x%u", (unsigned)(log_serial_dropped - log_serial_reported));
+				log_serial_reported = log_serial_dropped;
+				#ifdef OOPSY_TARGET_HAS_OLED
+				log_console(line);
+				#endif
+			}
+			#endif
+		}
+
+		void log_line(const char * line) {
+			#ifdef OOPSY_TARGET_HAS_OLED
+			log_console(line);
+			#endif
+			#ifdef OOPSY_LOG_SERIAL
+			// the USB stack sends from the buffer after TransmitInternal returns, 
+			// so a line is written into the buffer that isn't (or may not still be) in flight.
+			// if USB refuses it (busy, or no host), only the serial copy is dropped:
+			static char msgs[2][OOPSY_LOG_LINE + 2];
+			char * msg = msgs[log_serial_buffer ^ 1];
+			int len = snprintf(msg, OOPSY_LOG_LINE + 2, "%s\r\n", line);
+			if (sub_board->usb.TransmitInternal((uint8_t *)msg, len) == daisy::UsbHandle::Result::OK) {
+				log_serial_buffer ^= 1;
+			} else {
+				log_serial_dropped++;
+			}
+			#endif
+		}
+
+		#ifdef OOPSY_TARGET_HAS_OLED
+		void log_console(const char * line) {
+			if (console_lines) {
+				snprintf(console_lines[console_line], console_cols, "%s", line);
+				console_line = (console_line + 1) % console_rows;
+			}
+		}
+		#endif
+		#endif // OOPSY_HAS_LOG
+
 		#if OOPSY_TARGET_USES_MIDI_UART
+		// the sample clock now, as seen from the UART's receive interrupt:
+		uint32_t midi_in_frame_now() {
+			uint32_t clock, us;
+			// retry if an audio block started while reading:
+			do {
+				clock = midi_clock;
+				us = midi_clock_us;
+			} while (clock != midi_clock);
+			uint32_t frames = (uint32_t)((daisy::System::GetUs() - us) * midi_frames_per_us);
+			return clock + (frames < midi_block_size ? frames : midi_block_size - 1);
+		}
+
+		// called from the UART's interrupt, as bytes arrive (when the line goes idle, or the DMA buffer fills half way):
+		// stamps them with the sample clock, and queues them for the audio callback and the main loop.
+		// the bytes of a burst arrived one by one, 320us apart at 31250 baud, so they are stamped back from now;
+		// the stamps are delayed by a block so that they stay sample-accurate
+		static void midi_rx_callback(uint8_t * data, size_t size, void * context, daisy::UartHandler::Result result) {
+			GenDaisy& self = *(GenDaisy *)context;
+			if (result != daisy::UartHandler::Result::OK) return;
+			uint32_t now = self.midi_in_frame_now();
+			uint32_t frames_per_byte = (uint32_t)(320.f * self.midi_frames_per_us);
+			for (size_t i=0; i<size; i++) {
+				uint8_t byte = data[i];
+				uint32_t w = self.midi_in_queue_write, w1 = (w + 1) % OOPSY_MIDI_IN_QUEUE_SIZE;
+				// if the queue is full (no audio blocks, e.g. during an app load), drop it:
+				if (w1 != self.midi_in_queue_read) {
+					self.midi_in_queue[w].frame = now - (uint32_t)(size - 1 - i) * frames_per_byte;
+					self.midi_in_queue[w].byte = byte;
+					// the entry must be written before it is published:
+					__asm__ volatile("" ::: "memory");
+					self.midi_in_queue_write = w1;
+				}
+				w = self.midi_in_main_write, w1 = (w + 1) % OOPSY_MIDI_IN_QUEUE_SIZE;
+				if (w1 != self.midi_in_main_read) {
+					self.midi_in_main[w] = byte;
+					__asm__ volatile("" ::: "memory");
+					self.midi_in_main_write = w1;
+				}
+			}
+		}
+
+		// called from the main loop: the input that isn't the app's, i.e. thru, reboot and program changes
+		void midi_in_service() {
+			while (midi_in_main_read != midi_in_main_write) {
+				uint32_t r = midi_in_main_read;
+				uint8_t byte = midi_in_main[r];
+				midi_in_main_read = (r + 1) % OOPSY_MIDI_IN_QUEUE_SIZE;
+				if (byte == 0xFF) { // reset event -> go to bootloader
+					log("reboot");
+					daisy::System::ResetToBootloader();
+				}
+				if (midi_thru) midi_thru_byte(byte);
+				if (byte >= 0xF8) continue; // realtime doesn't affect running status
+				if (byte >= 128) {
+					midi_in_main_status = (byte < 0xF0) ? byte : 0;
+					continue;
+				}
+				#ifdef OOPSY_MULTI_APP
+				// program change -> app change:
+				if (midi_in_main_status/16 == 12) schedule_app_load(byte);
+				#endif
+			}
+		}
+
+		// queues a received byte for thru, in whole messages (with running status restored), 
+		// so that they can go out between the app's own messages
+		void midi_thru_byte(uint8_t byte) {
+			if (byte >= 0xF8) {
+				midi_out_thru.push(byte);
+				return;
+			}
+			if (byte >= 0x80) {
+				midi_thru_status = (byte < 0xF0) ? byte : 0;
+				midi_thru_sysex = (byte == 0xF0);
+				midi_thru_due = midi_data_length(byte);
+				midi_thru_len = 0;
+				// (system exclusive goes through byte by byte)
+				if (midi_thru_due == 0 || midi_thru_sysex) {
+					midi_thru_due = 0;
+					midi_out_thru.push(byte);
+				} else {
+					midi_thru_msg[midi_thru_len++] = byte;
+				}
+				return;
+			}
+			if (midi_thru_sysex) {
+				midi_out_thru.push(byte);
+				return;
+			}
+			if (midi_thru_due == 0) {
+				// data under running status starts another message (else it is stray):
+				if (!midi_thru_status) return;
+				midi_thru_msg[0] = midi_thru_status;
+				midi_thru_len = 1;
+				midi_thru_due = midi_data_length(midi_thru_status);
+			}
+			midi_thru_msg[midi_thru_len++] = byte;
+			if (--midi_thru_due == 0) {
+				if (midi_thru_len == 2) midi_out_thru.push(midi_thru_msg[0], midi_thru_msg[1]);
+				else midi_out_thru.push(midi_thru_msg[0], midi_thru_msg[1], midi_thru_msg[2]);
+				midi_thru_len = 0;
+			}
+		}
+
+		// called from the audio callback: the next queued byte, and its sample offset in this block
+		bool midi_in_pop(uint8_t& byte, size_t& offset) {
+			uint32_t r = midi_in_queue_read;
+			// (input goes to the incoming app during a crossfade)
+			if (r == midi_in_queue_write || app_fading) return false;
+			byte = midi_in_queue[r].byte;
+			int32_t frames = (int32_t)(midi_in_queue[r].frame - midi_in_block_frame);
+			// anything stamped before the last block (e.g. while an app was loading) goes at the start:
+			offset = frames < 0 ? 0 : frames < (int32_t)midi_block_size ? frames : midi_block_size - 1;
+			midi_in_queue_read = (r + 1) % OOPSY_MIDI_IN_QUEUE_SIZE;
+			return true;
+		}
+
+		// writes a byte to the [in N midi] signal at its offset, or the next free sample after the bytes before it
+		void midi_in_write(uint8_t byte, size_t offset, size_t size) {
+			if (offset < midi_in_written) offset = midi_in_written;
+			if (offset >= size) return;
+			// scale (0, 255) to (0.0, 1.0) to protect hardware from accidental patching
+			midi_in_data[offset] = byte / 256.0f;
+			midi_in_written = offset + 1;
+		}
+
 		void midi_postperform(float * buf, size_t size) {
-			size_t i = 0;
-			int8_t byte = buf[i] * 256.0f;
-			uint32_t w1 = (midi_out_writeidx+1) % OOPSY_MIDI_BUFFER_SIZE;
-			while (byte >= 0 && i < size && w1 != midi_out_readidx) {
-				// scale (0.0, 1.0) back to (0, 255) for MIDI bytes
-				midi_out_data[midi_out_writeidx] = byte;
-				midi_out_writeidx = w1;
-				w1 = (midi_out_writeidx+1) % OOPSY_MIDI_BUFFER_SIZE;
-				i++;
-				byte = buf[i] * 256.0f;
-			}
-			// for (size_t i=0; i<size && midi_out_writeidx+1 < OOPSY_MIDI_BUFFER_SIZE; i++) {
-			// 	if (buf[i] >= 0.f) {
-			// 		// scale (0.0, 1.0) back to (0, 255) for MIDI bytes
-			// 		midi_out_data[midi_out_written] = buf[i] * 256.0f;
-			// 		midi_out_written++;
-			// 	}
-			// }
+			for (size_t i=0; i<size; i++) {
+				// scale (0.0, 1.0) back to (0, 255) for MIDI bytes; the stream ends at the first negative value
+				int8_t byte = buf[i] * 256.0f;
+				if (byte < 0) break; 
+				midi_message1(byte);
+			}
 		}
 
+		// realtime bytes (clock, start, stop...) go ahead of everything else:
 		void midi_message1(uint8_t byte) {
-			uint32_t r = (midi_out_readidx + OOPSY_MIDI_BUFFER_SIZE - midi_out_writeidx) % OOPSY_MIDI_BUFFER_SIZE;
-			if (r > 0 && r <= 1) { log("midi buffer full"); return; }
-			uint32_t i0 = midi_out_writeidx;
-			uint32_t i1 = (midi_out_writeidx+1) % OOPSY_MIDI_BUFFER_SIZE;
-			midi_out_data[i0] = byte;
-			midi_out_writeidx = i1;
+			if (app_fading) return;
+			bool ok = (byte >= 0xF8) ? midi_out_realtime.push(byte) : midi_out.push(byte);
+			if (!ok) log("midi buffer full");
 		}
 
 		void midi_message2(uint8_t status, uint8_t b1) {
-			uint32_t r = (midi_out_readidx + OOPSY_MIDI_BUFFER_SIZE - midi_out_writeidx) % OOPSY_MIDI_BUFFER_SIZE;
-			if (r > 0 && r <= 2) { log("midi buffer full"); return; }
-			uint32_t i0 = midi_out_writeidx;
-			uint32_t i1 = (midi_out_writeidx+1) % OOPSY_MIDI_BUFFER_SIZE;
-			uint32_t i2 = (midi_out_writeidx+2) % OOPSY_MIDI_BUFFER_SIZE;
-			midi_out_data[i0] = status;
-			midi_out_data[i1] = b1;
-			midi_out_writeidx = i2;
+			if (app_fading) return;
+			if (!midi_out.push(status, b1)) log("midi buffer full");
 		}
 
 		void midi_message3(uint8_t status, uint8_t b1, uint8_t b2) {
-			uint32_t r = (midi_out_readidx + OOPSY_MIDI_BUFFER_SIZE - midi_out_writeidx) % OOPSY_MIDI_BUFFER_SIZE;
-			if (r > 0 && r <= 3) { log("midi buffer full"); return; }
-			uint32_t i0 = midi_out_writeidx;
-			uint32_t i1 = (midi_out_writeidx+1) % OOPSY_MIDI_BUFFER_SIZE;
-			uint32_t i2 = (midi_out_writeidx+2) % OOPSY_MIDI_BUFFER_SIZE;
-			uint32_t i3 = (midi_out_writeidx+3) % OOPSY_MIDI_BUFFER_SIZE;
-			midi_out_data[i0] = status;
-			midi_out_data[i1] = b1;
-			midi_out_data[i2] = b2;
-			midi_out_writeidx = i3;
+			if (app_fading) return;
+			if (!midi_out.push(status, b1, b2)) log("midi buffer full");
+		}
+
+		// replaces any unsent message in the slot, so a flood of changes costs no more bandwidth than the line has spare;
+		// these are sent after the realtime and message queues are empty
+		void midi_coalesce(int slot, uint8_t status, uint8_t b1, uint8_t b2=0) {
+			if (app_fading) return;
+			midi_out_slots[slot] = status | (b1 << 8) | (b2 << 16);
 		}
 
 		void midi_nullData(Data& data) {
@@ -1033,17 +3549,122 @@ namespace oopsy {
 
 		void midi_fromData(Data& data) {
 			double b = data.read(midi_data_idx, 0);
-			while (b >= 0. && midi_out_writeidx != midi_out_readidx) {
+			while (b >= 0. && midi_out.space()) {
 				// erase it from [data midi]
 				data.write(-1, midi_data_idx, 0);
 				// write it to our active outbuffer:
-				midi_out_data[midi_out_writeidx] = b;
-				midi_out_writeidx = (midi_out_writeidx+1) % OOPSY_MIDI_BUFFER_SIZE;
+				midi_out.push((uint8_t)b);
 				// and advance one index in the [data midi]
 				midi_data_idx++; if (midi_data_idx >= data.dim) midi_data_idx = 0;
 				b = data.read(midi_data_idx, 0);
 			}
 		}
+
+		void midi_out_reset() {
+			midi_out.clear();
+			midi_out_realtime.clear();
+			for (int i=0; i<OOPSY_MIDI_OUT_SLOTS; i++) midi_out_slots[i] = 0;
+			midi_out_status = midi_out_due = 0;
+			midi_out_sysex = false;
+			midi_out_msg_len = midi_out_msg_pos = 0;
+			midi_out_thru.clear();
+			midi_out_thru_open = false;
+			midi_thru_status = midi_thru_len = midi_thru_due = 0;
+			midi_thru_sysex = false;
+		}
+
+		// data bytes that follow a status byte
+		static uint8_t midi_data_length(uint8_t status) {
+			if (status < 0xF0) return ((status & 0xE0) == 0xC0) ? 1 : 2;
+			if (status == 0xF1 || status == 0xF3) return 1;
+			if (status == 0xF2) return 2;
+			return 0;
+		}
+
+		// tracks the outgoing stream, returning false for a status byte that running status makes redundant
+		bool midi_out_track(uint8_t byte) {
+			if (byte >= 0xF8) return true; // realtime doesn't affect running status
+			if (byte >= 0x80) {
+				if (byte < 0xF0 && byte == midi_out_status && midi_out_due == 0 && !midi_out_sysex) {
+					midi_out_due = midi_data_length(byte);
+					return false;
+				}
+				midi_out_status = (byte < 0xF0) ? byte : 0;
+				midi_out_due = midi_data_length(byte);
+				if (byte == 0xF0) midi_out_sysex = true;
+				else if (byte == 0xF7) midi_out_sysex = false;
+				return true;
+			}
+			if (midi_out_due) {
+				midi_out_due--;
+			} else if (midi_out_status && !midi_out_sysex) {
+				// data under running status starts another message:
+				midi_out_due = midi_data_length(midi_out_status) - 1;
+			}
+			return true;
+		}
+
+		// the next byte to send, or -1 if there is none
+		int midi_out_next() {
+			if (!midi_out_realtime.empty()) return midi_out_realtime.pop();
+			while (1) {
+				if (midi_out_msg_pos < midi_out_msg_len) {
+					uint8_t byte = midi_out_msg[midi_out_msg_pos++];
+					if (midi_out_track(byte)) return byte;
+				} else if (midi_out_thru_open) {
+					// a thru message has the line until it is complete:
+					if (midi_out_thru.empty()) return -1;
+					uint8_t byte = midi_out_thru.pop();
+					bool send = midi_out_track(byte);
+					if (midi_out_due == 0 && !midi_out_sysex) midi_out_thru_open = false;
+					if (send) return byte;
+				} else if (!midi_out.empty()) {
+					uint8_t byte = midi_out.pop();
+					if (midi_out_track(byte)) return byte;
+				} else if (midi_out_due == 0 && !midi_out_sysex && !midi_out_thru.empty()) {
+					midi_out_thru_open = true;
+				} else if (midi_out_due == 0 && !midi_out_sysex) {
+					// between messages, send the next continuous output that has changed, round-robin:
+					uint32_t msg = 0;
+					for (int n=0; n<OOPSY_MIDI_OUT_SLOTS && !msg; n++) {
+						int i = midi_out_slot_next;
+						midi_out_slot_next = (midi_out_slot_next + 1) % OOPSY_MIDI_OUT_SLOTS;
+						if (midi_out_slots[i]) msg = __atomic_exchange_n(&midi_out_slots[i], 0u, __ATOMIC_ACQUIRE);
+					}
+					if (!msg) return -1;
+					midi_out_msg[0] = msg;
+					midi_out_msg[1] = msg >> 8;
+					midi_out_msg[2] = msg >> 16;
+					midi_out_msg_len = 1 + midi_data_length(midi_out_msg[0]);
+					midi_out_msg_pos = 0;
+				} else {
+					return -1;
+				}
+			}
+		}
+
+		// called from the main loop: once the last transmit is done, starts a DMA transmit of the next few bytes, without waiting
+		void midi_out_service() {
+			if (midi_tx_busy) return;
+			size_t n = 0;
+			while (n < OOPSY_MIDI_TX_BATCH) {
+				int byte = midi_out_next();
+				if (byte < 0) break;
+				midi_tx_buffer[n++] = byte;
+			}
+			if (!n) return;
+			midi_tx_busy = true;
+			midi_out_active = 1;
+			if (uart.DmaTransmit(midi_tx_buffer, n, nullptr, midi_tx_complete, this) != daisy::UartHandler::Result::OK) {
+				// (the bytes are lost, as the line is in trouble anyway)
+				midi_tx_busy = false;
+			}
+		}
+
+		// called from the UART's DMA interrupt when a transmit is done:
+		static void midi_tx_complete(void * context, daisy::UartHandler::Result result) {
+			((GenDaisy *)context)->midi_tx_busy = false;
+		}
 		#endif //OOPSY_TARGET_USES_MIDI_UART
 
 		#if (OOPSY_TARGET_FIELD)
@@ -1060,8 +3681,14 @@ namespace oopsy {
 		#endif
 
 		static void nullAudioCallback(daisy::AudioHandle::InputBuffer ins, daisy::AudioHandle::OutputBuffer outs, size_t size);
+		#if (OOPSY_APP_SLOTS > 1)
+		static void crossfadeAudioCallback(daisy::AudioHandle::InputBuffer ins, daisy::AudioHandle::OutputBuffer outs, size_t size);
+		#endif
 		
 		static void nullMainloopCallback(uint32_t t, uint32_t dt) {}
+		#ifdef OOPSY_CONTROL_TASK
+		static void nullControlCallback() {}
+		#endif
 	} daisy;
 
 	void GenDaisy::nullAudioCallback(daisy::AudioHandle::InputBuffer ins, daisy::AudioHandle::OutputBuffer outs, size_t size) {
@@ -1072,6 +3699,53 @@ namespace oopsy {
 		}
 	}
 
+	#if (OOPSY_APP_SLOTS > 1)
+	// runs the outgoing app until the next one is ready, then both, mixing from one to the other over OOPSY_CROSSFADE_BLOCKS
+	void GenDaisy::crossfadeAudioCallback(daisy::AudioHandle::InputBuffer ins, daisy::AudioHandle::OutputBuffer outs, size_t size) {
+		uint32_t start = daisy::System::GetUs(); 
+		#ifdef OOPSY_USE_PROFILER
+		daisy.profiler.begin();
+		#endif
+		daisy.audio_preperform(size);
+		int remaining = daisy.fade_remaining;
+		float * fade_outs[OOPSY_IO_COUNT];
+		for (int i=0; i<OOPSY_IO_COUNT; i++) fade_outs[i] = (remaining > 0) ? daisy.fade_buffers[i] : outs[i];
+		if (remaining) {
+			// the main loop may be installing the next app, so the outgoing app gets its own pointers back while it runs:
+			void * app = daisy.app, * gen = daisy.gen;
+			daisy.app = daisy.fade_app;
+			daisy.gen = daisy.fade_gen;
+			daisy.app_fading = remaining > 0;
+			daisy.fade_perform(ins, fade_outs, size);
+			daisy.app_fading = false;
+			daisy.app = app;
+			daisy.gen = gen;
+		}
+		if (remaining >= 0) {
+			daisy.app_perform(ins, outs, size);
+		}
+		if (remaining > 0) {
+			// a linear ramp, continuous across blocks:
+			float g = remaining * (1.f/OOPSY_CROSSFADE_BLOCKS), dg = -(1.f/OOPSY_CROSSFADE_BLOCKS) / size;
+			for (size_t i=0; i<size; i++) {
+				for (int c=0; c<OOPSY_IO_COUNT; c++) {
+					outs[c][i] += g * (fade_outs[c][i] - outs[c][i]);
+				}
+				g += dg;
+			}
+			daisy.fade_remaining = remaining - 1;
+		}
+		#ifdef OOPSY_TARGET_USES_SDMMC
+		// the incoming app's streams only start playing once the app does:
+		if (remaining < 0) daisy.stream_advance_count = daisy.fade_stream_count;
+		#endif
+		daisy.audio_epilogue(ins, outs, size, start);
+		#ifdef OOPSY_TARGET_USES_SDMMC
+		daisy.stream_advance_count = -1;
+		#endif
+	}
+	#endif
+
 
 	// Curiously-recurring template to make App definitions simpler:
 	template<typename T>
@@ -1087,25 +3761,26 @@ namespace oopsy {
 			self.displayCallback(daisy, t, dt);
 		}
 
+		#ifdef OOPSY_CONTROL_TASK
+		static void staticControlCallback() {
+			T& self = *(T *)daisy.app;
+			self.controlCallback(daisy);
+		}
+		#endif
+
 		static void staticAudioCallback(daisy::AudioHandle::InputBuffer hardware_ins, daisy::AudioHandle::OutputBuffer hardware_outs, size_t size) {
 			uint32_t start = daisy::System::GetUs(); 
+			#ifdef OOPSY_USE_PROFILER
+			daisy.profiler.begin();
+			#endif
 			daisy.audio_preperform(size);
 			((T *)daisy.app)->audioCallback(daisy, hardware_ins, hardware_outs, size);
-			#if (OOPSY_IO_COUNT == 4)
-			float * buffers[] = {
-				(float *)hardware_ins[0], (float *)hardware_ins[1], (float *)hardware_ins[2], (float *)hardware_ins[3], 
-				hardware_outs[0], hardware_outs[1], hardware_outs[2], hardware_outs[3]};
-			#else
-			float * buffers[] = {(float *)hardware_ins[0], (float *)hardware_ins[1], hardware_outs[0], hardware_outs[1]};
-			#endif
-			daisy.audio_postperform(buffers, size);
-			// convert elapsed time (us) to CPU percentage (0-100) of available processing time
-			// 100 (%) * (0.000001 * used_us) * callbackrateHz
-			float percent = (daisy::System::GetUs() - start)*0.0001f*daisy.sub_board->AudioCallbackRate();
-			percent = percent > 100.f ? 100.f : percent;
-			// with a falling-only slew to capture spikes, since we care most about worst-case performance
-			daisy.audioCpuUsage = (percent > daisy.audioCpuUsage) ? percent 
-				: daisy.audioCpuUsage + 0.02f*(percent - daisy.audioCpuUsage);
+			daisy.audio_epilogue(hardware_ins, hardware_outs, size, start);
+		}
+
+		// just the app's part of the audio callback, for the crossfade callback to run
+		static void staticPerform(daisy::AudioHandle::InputBuffer hardware_ins, daisy::AudioHandle::OutputBuffer hardware_outs, size_t size) {
+			((T *)daisy.app)->audioCallback(daisy, hardware_ins, hardware_outs, size);
 		}
 
 		#if defined(OOPSY_TARGET_HAS_OLED) && defined(OOPSY_HAS_PARAM_VIEW)
@@ -1118,11 +3793,15 @@ namespace oopsy {
 
 }; // oopsy::
 
-void genlib_report_error(const char *s) { oopsy::daisy.log(s); }
-void genlib_report_message(const char *s) { oopsy::daisy.log(s); }
+void genlib_report_error(const char *s) { oopsy::daisy.log("%s", s); }
+void genlib_report_message(const char *s) { oopsy::daisy.log("%s", s); }
 
 unsigned long genlib_ticks() { 
+	#ifdef OOPSY_USE_PROFILER
+	return oopsy::Profiler::now();
+	#else
 	return 0; //daisy::System::GetTick(); 
+	#endif
 }
 
 t_ptr genlib_sysmem_newptr(t_ptr_size size) {
@@ -1135,5 +3814,214 @@ t_ptr genlib_sysmem_newptrclear(t_ptr_size size) {
 	return p;
 }
 
+t_ptr genlib_data_newptr(void *ref, long dim, long channels, long samplesize, int * preloaded) {
+	const oopsy::Placement * p = oopsy::placement_lookup((const char *)ref);
+	*preloaded = 0;
+	if (p && p->wavname) {
+		void * cached = oopsy::sample_cache.acquire(p->wavname, dim, channels, samplesize, p->planar, *preloaded);
+		if (cached) return (t_ptr)cached;
+	}
+	return (t_ptr)oopsy::allocate(samplesize * dim * channels, p ? p->region : oopsy::placement);
+}
+
+void genlib_sysmem_freeptr(void *ptr) {
+	oopsy::free(ptr);
+}
+
+namespace oopsy {
+	// a [data] that Oopsy allocates itself, storing samples as T, interleaved or PLANAR
+	// oopsy.js substitutes one for Data in the exported code of a [data foo_int16] and/or [data foo_planar]
+	template<typename T, bool PLANAR>
+	struct DataStore : public DataInterface<T, PLANAR> {
+		~DataStore() {
+			if (this->mData) genlib_sysmem_freeptr(this->mData);
+			this->mData = 0;
+		}
+
+		void reset(const char * name, long s, long c) {
+			if (s * c > DATA_MAXIMUM_ELEMENTS) {
+				s = DATA_MAXIMUM_ELEMENTS/c;
+				genlib_report_message("warning: constraining [data] to < 256MB");
+			}
+			if (this->mData && s * c == this->dim * this->channels) {
+				// no need to re-allocate, just clear:
+				this->dim = s;
+				this->channels = c;
+				memset(this->mData, 0, sizeof(T) * s * c);
+				oopsy::sample_cache.invalidate(this->mData);
+				return;
+			}
+			if (this->mData && oopsy::resize(this->mData, sizeof(T) * s * c)) {
+				this->dim = s;
+				this->channels = c;
+				memset(this->mData, 0, sizeof(T) * s * c);
+				return;
+			}
+			if (this->mData) genlib_sysmem_freeptr(this->mData);
+			int preloaded = 0;
+			this->mData = (T *)genlib_data_newptr(genlib_obtain_reference_from_string(name), s, c, sizeof(T), &preloaded);
+			if (!this->mData) {
+				genlib_report_error("data: out of memory");
+				this->dim = 0;
+				if (s > 512 || c > 1) reset(name, 512, 1);
+				return;
+			}
+			this->dim = s;
+			this->channels = c;
+			if (!preloaded) memset(this->mData, 0, sizeof(T) * s * c);
+		}
+
+		// the frames of one channel, one after another (planar data only)
+		inline T * plane(long channel) { return this->mData + channel * this->dim; }
+
+		// buffer~ references aren't supported on the Daisy
+		bool setbuffer(void *bufferRef) { return false; }
+	};
+	// in half the memory of a Data:
+	typedef DataStore<int16_t, false> Data16;
+	// each channel contiguous, for voices that read one channel over many frames:
+	typedef DataStore<t_sample, true> DataPlanar;
+	typedef DataStore<int16_t, true> DataPlanar16;
+
+	// a [delay] of exactly its maximum length rather than rounded up to a power of two,
+	// storing samples as T (float, or int16_t for half the memory again)
+	// oopsy.js substitutes it for Delay in the exported code of a delay named foo_exact or foo_int16
+	// the ring is one longer than the maximum delay, so a tap at maxdelay never reads the sample being written
+	template<typename T>
+	struct DelayCompact {
+		T *memory;
+		long size, maxdelay;
+		long reader, writer;
+
+		DelayCompact() : memory(0) {
+			size = maxdelay = 0;
+			reader = writer = 0;
+		}
+		~DelayCompact() {
+			if (memory) genlib_sysmem_freeptr(memory);
+			memory = 0;
+		}
+
+		inline void reset(const char *name, long d) {
+			if (!memory) {
+				maxdelay = d < 1 ? 1 : d;
+				size = maxdelay + 1;
+				int preloaded = 0;
+				memory = (T *)genlib_data_newptr(genlib_obtain_reference_from_string(name), size, 1, sizeof(T), &preloaded);
+				if (!memory) {
+					genlib_report_error("delay: out of memory");
+					size = maxdelay = 0;
+					return;
+				}
+			}
+			oopsy::memset(memory, 0, sizeof(T) * size);
+			reader = writer = 0;
+		}
+
+		// index i wrapped into the ring, for 0 <= i < 2*size
+		inline long wrapped(long i) const { return i >= size ? i - size : i; }
+		inline long next(long i) const { return i+1 >= size ? 0 : i+1; }
+		inline t_sample at(long i) const { return DataSample<T>::load(memory[i]); }
+
+		inline void step() {
+			reader = next(reader);
+		}
+
+		inline void write(t_sample x) {
+			writer = reader;
+			memory[writer] = DataSample<T>::store(x);
+		}
+
+		// read position for a delay of d, clamped to lo..maxdelay, split into index & fraction
+		inline long position(t_sample d, t_sample lo, t_sample& a) const {
+			const t_sample r = t_sample(size + reader) - clamp(d, lo, t_sample(maxdelay));
+			long r1 = long(r);
+			a = r - (t_sample)r1;
+			return wrapped(r1);
+		}
+
+		inline t_sample read_step(t_sample d) {
+			t_sample a;
+			return at(position(d-t_sample(0.5), t_sample(reader != writer), a));
+		}
+
+		inline t_sample read_linear(t_sample d) {
+			t_sample a;
+			long i1 = position(d, t_sample(reader != writer), a);
+			return linear_interp(a, at(i1), at(next(i1)));
+		}
+
+		inline t_sample read_cosine(t_sample d) {
+			t_sample a;
+			long i1 = position(d, t_sample(reader != writer), a);
+			return cosine_interp(a, at(i1), at(next(i1)));
+		}
+
+		// 4-point reads require an extra sample of compensation:
+		inline t_sample read_fastcubic(t_sample d) {
+			t_sample a;
+			long i1 = position(d, t_sample(1.) + t_sample(reader != writer), a);
+			long i2 = next(i1), i3 = next(i2), i4 = next(i3);
+			return fastcubic_interp(a, at(i1), at(i2), at(i3), at(i4));
+		}
+
+		inline t_sample read_cubic(t_sample d) {
+			t_sample a;
+			long i1 = position(d, t_sample(1.) + t_sample(reader != writer), a);
+			long i2 = next(i1), i3 = next(i2), i4 = next(i3);
+			return cubic_interp(a, at(i1), at(i2), at(i3), at(i4));
+		}
+
+		inline t_sample read_spline(t_sample d) {
+			t_sample a;
+			long i1 = position(d, t_sample(1.) + t_sample(reader != writer), a);
+			long i2 = next(i1), i3 = next(i2), i4 = next(i3);
+			return spline_interp(a, at(i1), at(i2), at(i3), at(i4));
+		}
+
+		inline t_sample read_spline6(t_sample d) {
+			t_sample a;
+			long i0 = position(d, t_sample(1.) + t_sample(reader != writer), a);
+			long i1 = next(i0), i2 = next(i1), i3 = next(i2), i4 = next(i3), i5 = next(i4);
+			return spline6_interp(a, at(i0), at(i1), at(i2), at(i3), at(i4), at(i5));
+		}
+
+		// the same block API as Delay: delays shorter than the block are clamped to n
+		inline void read_block(t_sample *out, t_sample d, long n) const {
+			t_sample a;
+			long first = position(d-t_sample(0.5), t_sample(n), a);
+			for (long i=0; i<n; first=0) {
+				long len = (size - first < n - i) ? size - first : n - i;
+				for (long j=0; j<len; j++) out[i + j] = at(first + j);
+				i += len;
+			}
+		}
+
+		inline void read_linear_block(t_sample *out, const t_sample *d, long n) const {
+			const t_sample lo = t_sample(n), hi = t_sample(maxdelay);
+			t_sample base = t_sample(size + reader);
+			for (long i=0; i<n; i++, base += t_sample(1.)) {
+				const t_sample r = base - clamp(d[i], lo, hi);
+				long r1 = long(r);
+				t_sample a = r - (t_sample)r1;
+				long i1 = wrapped(r1);
+				out[i] = linear_interp(a, at(i1), at(next(i1)));
+			}
+		}
+
+		inline void write_block(const t_sample *in, long n) {
+			for (long i=0, w=reader; i<n; w=0) {
+				long len = (size - w < n - i) ? size - w : n - i;
+				for (long j=0; j<len; j++) memory[w + j] = DataSample<T>::store(in[i + j]);
+				i += len;
+			}
+			reader = (reader + n) % size;
+			writer = reader ? reader - 1 : size - 1;
+		}
+	};
+	typedef DelayCompact<t_sample> DelayExact;
+	typedef DelayCompact<int16_t> Delay16;
+}
+
 
 #endif //GENLIB_DAISY_H
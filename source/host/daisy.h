@@ -0,0 +1,252 @@
+#ifndef OOPSY_HOST_DAISY_H
+#define OOPSY_HOST_DAISY_H
+
+/*
+Oopsy was authored in 2020-2021 by Graham Wakefield.  Copyright 2021 Electrosmith, Corp. and Graham Wakefield.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// A stand-in for the parts of libDaisy (and FatFS/CMSIS) that genlib_daisy.h uses,
+// so that generated apps can be built and run on the host by `oopsy.js host`.
+// Peripherals do nothing; files on the "SD card" are read from the working directory.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <chrono>
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+// memory sections are ordinary statics on the host:
+#define DSY_SDRAM_BSS
+#define DTCM_MEM_SECTION
+#define DMA_BUFFER_MEM_SECTION
+
+#define FLT_FMT3 "%d.%03d"
+#define FLT_VAR3(x) (int)(x), (int)(((x)-(int)(x))*1000)
+
+typedef struct { int port; uint8_t pin; } dsy_gpio_pin;
+enum { DSY_GPIOA, DSY_GPIOB, DSY_GPIOC, DSY_GPIOD };
+
+// cache maintenance and barriers (for SDMMC DMA) have nothing to do:
+inline void SCB_CleanInvalidateDCache_by_Addr(uint32_t *, int32_t) {}
+inline void SCB_InvalidateDCache_by_Addr(uint32_t *, int32_t) {}
+inline void SCB_CleanDCache_by_Addr(uint32_t *, int32_t) {}
+inline void __DMB() {}
+// the bench's audio callback is called from the same thread, so there is nothing to mask:
+inline void __disable_irq() {}
+inline void __enable_irq() {}
+
+// the FPU's flush-to-zero and default-NaN bits go to the host's own control register (SSE has no default-NaN mode);
+// interrupts don't have a separate default:
+#define FPU_FPDSCR_FZ_Msk (1UL << 24)
+#define FPU_FPDSCR_DN_Msk (1UL << 25)
+typedef struct { uint32_t FPDSCR; } FPU_Type;
+static FPU_Type host_fpu = { 0 };
+#define FPU (&host_fpu)
+static uint32_t host_fpscr = 0;
+inline uint32_t __get_FPSCR() { return host_fpscr; }
+inline void __set_FPSCR(uint32_t fpscr) {
+	host_fpscr = fpscr;
+	#if defined(__SSE__)
+	// flush-to-zero and denormals-are-zero:
+	if (fpscr & FPU_FPDSCR_FZ_Msk) _mm_setcsr(_mm_getcsr() | 0x8040);
+	#elif defined(__aarch64__)
+	// FZ and DN are the same bits in the FPCR:
+	uint64_t fpcr;
+	__asm__ volatile("mrs %0, fpcr" : "=r"(fpcr));
+	fpcr |= fpscr & (FPU_FPDSCR_FZ_Msk | FPU_FPDSCR_DN_Msk);
+	__asm__ volatile("msr fpcr, %0" :: "r"(fpcr));
+	#endif
+}
+
+////////////////////////// FATFS //////////////////////////
+
+typedef int FRESULT;
+enum { FR_OK = 0, FR_NO_FILE = 4 };
+typedef size_t UINT; // (unsigned int on the Daisy, which is the same size as size_t there)
+typedef uint32_t FSIZE_t;
+typedef struct { FILE * fp; } FIL;
+typedef struct { int unused; } FATFS;
+#define FA_READ 0x01
+#define FA_WRITE 0x02
+#define FA_OPEN_EXISTING 0x00
+#define FA_CREATE_ALWAYS 0x08
+
+inline FRESULT f_mount(FATFS *, const char *, int) { return FR_OK; }
+inline FRESULT f_open(FIL * f, const char * path, int mode) {
+	f->fp = fopen(path, (mode & FA_WRITE) ? "wb" : "rb");
+	return f->fp ? FR_OK : FR_NO_FILE;
+}
+inline FRESULT f_close(FIL * f) {
+	if (f->fp) fclose(f->fp);
+	f->fp = nullptr;
+	return FR_OK;
+}
+inline FRESULT f_read(FIL * f, void * buf, UINT len, UINT * read) {
+	*read = f->fp ? (UINT)fread(buf, 1, len, f->fp) : 0;
+	return FR_OK;
+}
+inline FRESULT f_write(FIL * f, const void * buf, UINT len, UINT * written) {
+	*written = f->fp ? (UINT)fwrite(buf, 1, len, f->fp) : 0;
+	return FR_OK;
+}
+inline FRESULT f_lseek(FIL * f, FSIZE_t offset) { return (f->fp && fseek(f->fp, offset, SEEK_SET) == 0) ? FR_OK : 1; }
+inline FSIZE_t f_tell(FIL * f) { return f->fp ? (FSIZE_t)ftell(f->fp) : 0; }
+inline FSIZE_t f_size(FIL * f) {
+	if (!f->fp) return 0;
+	long pos = ftell(f->fp);
+	fseek(f->fp, 0, SEEK_END);
+	long size = ftell(f->fp);
+	fseek(f->fp, pos, SEEK_SET);
+	return (FSIZE_t)size;
+}
+inline int f_eof(FIL * f) { return f->fp ? f_tell(f) >= f_size(f) : 1; }
+
+namespace daisy {
+
+static const uint32_t kWavFileChunkId = 0x46464952; // "RIFF"
+static const uint32_t kWavFileWaveId = 0x45564157; // "WAVE"
+static const uint32_t kWavFileSubChunk1Id = 0x20746d66; // "fmt "
+static const uint32_t kWavFileSubChunk2Id = 0x61746164; // "data"
+
+struct System {
+	static uint64_t now_us() {
+		using namespace std::chrono;
+		static const steady_clock::time_point start = steady_clock::now();
+		return duration_cast<microseconds>(steady_clock::now() - start).count();
+	}
+	static uint32_t GetNow() { return (uint32_t)(now_us() / 1000); }
+	static uint32_t GetUs() { return (uint32_t)now_us(); }
+	static uint32_t GetTick() { return (uint32_t)now_us(); }
+	static void Delay(uint32_t) {}
+	static void DelayUs(uint32_t) {}
+	static void ResetToBootloader() { exit(0); }
+};
+
+struct AudioHandle {
+	typedef const float * const * InputBuffer;
+	typedef float ** OutputBuffer;
+	typedef void (*AudioCallback)(InputBuffer in, OutputBuffer out, size_t size);
+};
+
+struct SaiHandle {
+	struct Config {
+		enum class SampleRate { SAI_8KHZ, SAI_16KHZ, SAI_32KHZ, SAI_48KHZ, SAI_96KHZ };
+	};
+};
+
+struct AdcHandle {
+	void Start() {}
+};
+
+struct UsbHandle {
+	enum UsbPeriph { FS_INTERNAL };
+	typedef void (*ReceiveCallback)(uint8_t * buf, uint32_t * len);
+	void Init(UsbPeriph) {}
+	void SetReceiveCallback(ReceiveCallback, UsbPeriph) {}
+	enum class Result { OK, ERR };
+	Result TransmitInternal(uint8_t * buf, size_t size) { return fwrite(buf, 1, size, stdout) == size ? Result::OK : Result::ERR; }
+};
+
+struct UartHandler {
+	enum class Result { OK, ERR };
+	struct Config {
+		enum class Peripheral { USART_1 };
+		enum class StopBits { BITS_1 };
+		enum class Parity { NONE };
+		enum class Mode { TX_RX };
+		enum class WordLength { BITS_8 };
+		uint32_t baudrate;
+		Peripheral periph;
+		StopBits stopbits;
+		Parity parity;
+		Mode mode;
+		WordLength wordlength;
+		struct { dsy_gpio_pin rx, tx; } pin_config;
+	};
+	typedef void (*CircularRxCallbackFunctionPtr)(uint8_t * data, size_t size, void * context, Result result);
+	Result Init(const Config&) { return Result::OK; }
+	// nothing is ever received:
+	Result DmaListenStart(uint8_t *, size_t, CircularRxCallbackFunctionPtr, void *) { return Result::OK; }
+	typedef void (*StartCallbackFunctionPtr)(void * context);
+	typedef void (*EndCallbackFunctionPtr)(void * context, Result result);
+	Result PollTx(uint8_t *, size_t) { return Result::OK; }
+	// MIDI out goes nowhere, and is done at once:
+	Result DmaTransmit(uint8_t *, size_t, StartCallbackFunctionPtr, EndCallbackFunctionPtr end, void * context) {
+		if (end) end(context, Result::OK);
+		return Result::OK;
+	}
+};
+
+struct SdmmcHandler {
+	enum class BusWidth { BITS_1, BITS_4 };
+	enum class Speed { SLOW, MEDIUM_SLOW, STANDARD, FAST, VERY_FAST };
+	struct Config {
+		BusWidth width;
+		Speed speed;
+		bool clock_powersave;
+		void Defaults() { width = BusWidth::BITS_4; speed = Speed::FAST; clock_powersave = false; }
+	};
+	void Init(const Config&) {}
+};
+
+struct FatFSInterface {
+	struct Config { enum Media { MEDIA_SD = 1 }; };
+	FATFS fs;
+	void Init(int) {}
+	FATFS& GetSDFileSystem() { return fs; }
+	const char * GetSDPath() { return ""; }
+};
+
+enum LoggerDestination { LOGGER_INTERNAL };
+template<LoggerDestination D> 
+struct Logger {
+	static void StartLog(bool) {}
+};
+
+// the audio configuration is set by the bench, and the callback is run by it rather than by SAI DMA
+struct DaisySeed {
+	enum { MAX_CHANNELS = 8, MAX_BLOCK_SIZE = 256 };
+
+	AdcHandle adc;
+	UsbHandle usb;
+	float samplerate = 48000.f;
+	size_t blocksize = 48;
+	AudioHandle::AudioCallback callback = nullptr;
+
+	void Init(bool boost = false) {}
+	float AudioSampleRate() { return samplerate; }
+	size_t AudioBlockSize() { return blocksize; }
+	float AudioCallbackRate() { return samplerate / blocksize; }
+	void SetAudioBlockSize(size_t size) { blocksize = size; }
+	void StartAudio(AudioHandle::AudioCallback cb) { ChangeAudioCallback(cb); }
+	// on hardware, the next SAI interrupt runs the new callback; GenDaisy::reset() waits for that
+	void ChangeAudioCallback(AudioHandle::AudioCallback cb) { 
+		static float silence[MAX_CHANNELS][MAX_BLOCK_SIZE];
+		static float scratch[MAX_CHANNELS][MAX_BLOCK_SIZE];
+		static const float * ins[MAX_CHANNELS];
+		static float * outs[MAX_CHANNELS];
+		for (int i=0; i<MAX_CHANNELS; i++) {
+			ins[i] = silence[i];
+			outs[i] = scratch[i];
+		}
+		callback = cb;
+		if (callback) callback(ins, outs, blocksize);
+	}
+	void SetLed(bool) {}
+	template<typename... A> static void PrintLine(const char * fmt, A... args) { printf(fmt, args...); printf("\n"); }
+};
+
+} // daisy::
+
+#endif // OOPSY_HOST_DAISY_H
@@ -0,0 +1,29 @@
+#ifndef OOPSY_HOST_DAISY_HOST_H
+#define OOPSY_HOST_DAISY_HOST_H
+
+#include "daisy.h"
+
+namespace daisy {
+
+// a board for the bench: knobs and gates are values that the bench sets each block
+struct DaisyHost {
+	enum { KNOB_COUNT = 4, GATE_COUNT = 2 };
+
+	DaisySeed seed;
+	float knobs[KNOB_COUNT] = {};
+	bool gates[GATE_COUNT] = {};
+
+	void Init(bool boost = false) { seed.Init(boost); }
+	void SetAudioSampleRate(float hz) { seed.samplerate = hz; }
+	void SetAudioBlockSize(size_t size) { seed.SetAudioBlockSize(size); }
+	float AudioSampleRate() { return seed.AudioSampleRate(); }
+	size_t AudioBlockSize() { return seed.AudioBlockSize(); }
+	void ProcessAllControls() {}
+
+	float GetKnobValue(int idx) { return knobs[idx]; }
+	bool GetGate(int idx) { return gates[idx]; }
+};
+
+} // daisy::
+
+#endif // OOPSY_HOST_DAISY_HOST_H
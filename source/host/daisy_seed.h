@@ -0,0 +1,2 @@
+// on the host, the seed is declared along with the rest of the libDaisy stand-in:
+#include "daisy.h"
@@ -0,0 +1,144 @@
+#ifndef OOPSY_HOST_H
+#define OOPSY_HOST_H
+
+/*
+Oopsy was authored in 2020-2021 by Graham Wakefield.  Copyright 2021 Electrosmith, Corp. and Graham Wakefield.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// The benchmark run by `oopsy.js host`: each app is loaded at each samplerate and block size,
+// and its audio callback is timed over synthetic input. Included after genlib_daisy.cpp.
+
+#include <chrono>
+
+namespace oopsy {
+
+	struct HostBench {
+		const int * rates;	// Hz
+		int rate_count;
+		const int * blocks;
+		int block_count;
+		float seconds;		// of audio per configuration
+
+		float ins[daisy::DaisySeed::MAX_CHANNELS][daisy::DaisySeed::MAX_BLOCK_SIZE];
+		float outs[daisy::DaisySeed::MAX_CHANNELS][daisy::DaisySeed::MAX_BLOCK_SIZE];
+		uint32_t seed = 1;
+
+		// deterministic white noise in -1..1
+		inline float noise() {
+			seed = seed * 1664525u + 1013904223u;
+			return (int32_t)seed * (1.f/2147483648.f);
+		}
+
+		// noise on every input, with an impulse at the start; knobs sweep slowly and gates toggle every second
+		void synthesize(Daisy& hardware, size_t frame, size_t size, float samplerate) {
+			for (int c=0; c<OOPSY_IO_COUNT; c++) {
+				for (size_t i=0; i<size; i++) ins[c][i] = 0.25f * noise();
+				if (frame == 0) ins[c][0] = 1.f;
+			}
+			float phase = frame / samplerate;
+			for (int k=0; k<Daisy::KNOB_COUNT; k++) {
+				hardware.knobs[k] = 0.5f + 0.5f * sinf(6.2831853f * phase * 0.1f * (k+1));
+			}
+			for (int g=0; g<Daisy::GATE_COUNT; g++) {
+				hardware.gates[g] = (int(phase) + g) % 2;
+			}
+		}
+
+		// times one app at one configuration, printing one line of results
+		void measure(GenDaisy& daisy, int app, int rate, int block) {
+			daisy.hardware.SetAudioSampleRate(rate);
+			daisy.hardware.SetAudioBlockSize(block);
+			daisy.app_selected = daisy.app_selecting = app;
+			daisy.appdefs[app].load();
+
+			uint32_t used[REGION_COUNT];
+			for (int i=0; i<REGION_COUNT; i++) used[i] = arenas[i].used;
+
+			const float * inputs[daisy::DaisySeed::MAX_CHANNELS];
+			float * outputs[daisy::DaisySeed::MAX_CHANNELS];
+			for (int i=0; i<daisy::DaisySeed::MAX_CHANNELS; i++) {
+				inputs[i] = ins[i];
+				outputs[i] = outs[i];
+			}
+
+			// the main loop runs between blocks (for background wav loads etc.), but isn't timed:
+			size_t blocks = (size_t)(seconds * rate / block);
+			uint64_t total_ns = 0, worst_ns = 0;
+			for (size_t b=0; b<blocks; b++) {
+				synthesize(daisy.hardware, b * block, block, (float)rate);
+				#ifdef OOPSY_CONTROL_TASK
+				// the control task runs outside the audio callback, so it isn't timed either:
+				daisy.control_scan();
+				daisy.controlCallback();
+				#endif
+				auto t0 = std::chrono::steady_clock::now();
+				daisy.sub_board->callback(inputs, outputs, block);
+				auto t1 = std::chrono::steady_clock::now();
+				uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+				total_ns += ns;
+				if (ns > worst_ns) worst_ns = ns;
+				daisy.mainloopCallback(daisy::System::GetNow(), 1);
+				release_retired(daisy.blockcount);
+				#ifdef OOPSY_HAS_LOG
+				daisy.log_service();
+				#endif
+				#ifdef OOPSY_TARGET_USES_SDMMC
+				daisy.sdcard_stream_service();
+				daisy.sdcard_load_service();
+				#endif
+			}
+
+			// memory is only meant to be allocated when an app loads:
+			bool allocated = false;
+			for (int i=0; i<REGION_COUNT; i++) allocated |= arenas[i].used != used[i];
+
+			double ns_per_sample = blocks ? double(total_ns) / (blocks * block) : 0.;
+			// the share of the real-time budget this host would need:
+			double realtime = ns_per_sample * rate * 1e-7;
+			char region_used[REGION_COUNT][8];
+			for (int i=0; i<REGION_COUNT; i++) format_bytes(region_used[i], sizeof(region_used[i]), arenas[i].highwater);
+			printf("%-16s %3dkHz %4d %10.2f %8.2f %8.2f%% %6s %6s %6s%s\n",
+				daisy.appdefs[app].name, rate/1000, block, ns_per_sample, worst_ns * 1e-3, realtime,
+				region_used[REGION_DTCM], region_used[REGION_SRAM], region_used[REGION_SDRAM],
+				allocated ? " allocated in audio!" : "");
+		}
+
+		int run(GenDaisy& daisy, AppDef * appdefs, int count) {
+			daisy.appdefs = appdefs;
+			daisy.app_count = count;
+			daisy.mode = 0;
+			oopsy::init();
+			fpu_flush_to_zero();
+			daisy.mainloopCallback = GenDaisy::nullMainloopCallback;
+			daisy.displayCallback = GenDaisy::nullMainloopCallback;
+			#ifdef OOPSY_CONTROL_TASK
+			daisy.controlCallback = GenDaisy::nullControlCallback;
+			#endif
+			#ifdef OOPSY_TARGET_USES_SDMMC
+			daisy.sdcard_init();
+			#endif
+			// anything allocated before this point persists across app loads:
+			daisy.app_scope.begin();
+
+			printf("%-16s %6s %4s %10s %8s %9s %6s %6s %6s\n",
+				"app", "rate", "blk", "ns/sample", "worst us", "realtime", "dtcm", "sram", "sdram");
+			for (int app=0; app<count; app++) {
+				for (int r=0; r<rate_count; r++) {
+					for (int b=0; b<block_count; b++) {
+						measure(daisy, app, rates[r], blocks[b]);
+					}
+				}
+			}
+			return 0;
+		}
+	};
+
+}; // oopsy::
+
+#endif // OOPSY_HOST_H
@@ -63,6 +63,20 @@ const template = (template, vars = {}) => {
 	return handler(vars);
 };
 
+// the deadband of a param driven by an input, in the param's own units
+function param_deadband(node, input) {
+	let deadband = (input && input.deadband != undefined) ? input.deadband : OOPSY_PARAM_DEADBAND
+	return deadband * Math.abs(node.range)
+}
+
+// the generated update of a float param driven by an input, through its deadband;
+// within the deadband of either end it snaps to that end, so that the param can still reach its min and max
+function param_deadband_update(node, input) {
+	let deadband = param_deadband(node, input)
+	let lo = Math.min(node.min, node.min + node.range), hi = Math.max(node.min, node.min + node.range)
+	return `{ float v = ${node.src}*${asCppNumber(node.range)} + ${asCppNumber(node.min)}; if (v >= ${asCppNumber(hi - deadband)}) v = ${asCppNumber(hi)}; else if (v <= ${asCppNumber(lo + deadband)}) v = ${asCppNumber(lo)}; if (fabsf(v - ${node.varname}) > ${asCppNumber(deadband)} || (v != ${node.varname} && (v == ${asCppNumber(lo)} || v == ${asCppNumber(hi)}))) ${node.varname} = v; }`
+}
+
 // prints a number as a C-style float:
 function asCppNumber(n, type="float") {
 	let s = (+n).toString();
@@ -123,6 +137,10 @@ const help = `
 
 cmds: 	up/upload = (default) generate & upload
 	  	gen/generate = generate only
+	  	host = generate, build & benchmark on this computer (with a stand-in for libDaisy)
+		       at each samplerate and block size given (or all of them), reporting ns/sample and memory
+	  	bench = generate & upload a build that times each block size given (or all of them) on the Daisy,
+		       reporting cycles/sample, the worst block and memory over USB serial
 
 target: path to a JSON for the hardware config, 
 		or simply "patch", "patch_sm", "field", "petal", "pod" etc. 
@@ -134,10 +152,48 @@ block1, block2, etc. up to block256 will set the block size
 
 fastmath will replace some expensive math operations with faster approximations
 
+armmath will use the CMSIS-DSP library for sin/cos/sqrt and for block fills and copies
+
+ftz will compile gen~'s per-sample fixdenorm and fixnan to nothing, relying on the FPU's flush-to-zero mode instead
+		(a patch that can make a NaN, e.g. from 0/0 in feedback, will then stay silent)
+
 boost will increase the CPU from 400Mhz to 480Mhz
 
 nooled will disable code generration for OLED (it will be blank)
 
+profile will time each stage of the audio callback in CPU cycles, shown on an OLED page and sent over USB serial on "prof"
+
+logserial will send the console's log messages over USB serial too (on the host, to stdout)
+
+usbserial will start USB serial, for "prof" and "save" (which targets without an OLED start anyway)
+
+sd4bit will use the 4-bit SD card bus rather than 1-bit (if the board wires it)
+
+sdfast will clock the SD card bus at 100MHz rather than 50MHz
+
+control1000Hz etc. will scan the knobs, switches and gates from the main loop at that rate rather than in the audio callback,
+		which then only reads the latest snapshot of them
+
+snapshot will keep each app's params and any [data foo_snapshot] in QSPI flash, restored when the app loads,
+		and saved when a param tweak on the OLED is done (or on "save" over USB serial)
+
+sineflash will share one 64KB cosine table in flash between every cycle that has no buffer,
+		rather than each computing its own into RAM (the table takes half of the Seed's 128KB of flash)
+
+fixed will compile each app for exactly the samplerate and block size given, as constants,
+		so that the compiler can unroll block loops and fold samplerate math (not for host or bench)
+
+crossfade16 etc. will load the next app while the current one keeps playing, then crossfade between them over that many blocks
+		(with more than one app; apps that don't fit in memory together still switch with a gap)
+
+voices8 etc. will run any gen~ patcher with [param voice_pitch], [param voice_vel] or [param voice_gate] as that many voices,
+		playing MIDI notes, and only performing the voices that are sounding
+		once every voice is sounding, a new note takes the oldest (or with stealquietest, the quietest) voice,
+		or with nosteal, is dropped; released voices are always taken first
+
+idle (or idle2000 etc., in ms) will stop performing an app once its inputs and outputs have been silent for that long
+		(1000ms by default, or the seconds of a [param idle_hold] in the patcher), until an input, MIDI or a param change wakes it
+
 cpps: 	paths to the gen~ exported cpp files
 		first item will be the default app
 		  
@@ -153,7 +209,7 @@ const component_defs = {
 		polarity: "daisy::Switch::POLARITY_INVERTED",
 		pull: "daisy::Switch::PULL_UP",
 		process: "${name}.Debounce();",
-		updaterate: "${name}.SetUpdateRate(seed.AudioCallbackRate());",
+		updaterate: "${name}.SetUpdateRate(ControlRate());",
 		mapping: [
 			{ name: "${name}", get: "(hardware.${name}.Pressed()?1.f:0.f)", range: [0, 1] },
 			{
@@ -184,7 +240,7 @@ const component_defs = {
 		typename: "daisy::Encoder",
 		pin: "a,b,click",
 		process: "${name}.Debounce();",
-		updaterate: "${name}.SetUpdateRate(seed.AudioCallbackRate());",
+		updaterate: "${name}.SetUpdateRate(ControlRate());",
 		mapping: [
 			{
 				name: "${name}",
@@ -226,9 +282,9 @@ const component_defs = {
 		pin: "a",
 		flip: false,
 		invert: false,
-		slew: "1.0/seed.AudioCallbackRate()",
+		slew: "1.0/ControlRate()",
 		process: "${name}.Process();",
-		updaterate: "${name}.SetSampleRate(seed.AudioCallbackRate());",
+		updaterate: "${name}.SetSampleRate(ControlRate());",
 		mapping: [{ name: "${name}", get: "(hardware.${name}.Value())", range: [0, 1] }]
 	},
 	Led: {
@@ -282,6 +338,19 @@ const component_defs = {
 	}
 };
 
+// region sizes in bytes, these should match genlib_daisy.h
+const OOPSY_DTCM_SIZE = 32 * 1024
+const OOPSY_SRAM_SIZE = 512 * 1024
+// a [delay] up to this size is considered small and hot (e.g. allpass, comb, short echo)
+// larger delays and any [data] used for sample storage are large and cold
+const OOPSY_HOT_DELAY_BYTES = 64 * 1024
+const OOPSY_HOT_DATA_BYTES = 16 * 1024
+// entries in the cosine table used by cycle, matching GENLIB_SINE_TABLE_SIZE in genlib_ops.h
+const SINE_TABLE_SIZE = 1 << 14
+// a knob/CV mapped param is only updated when its input moves by more than this (0..1 units)
+// an input in the target JSON can override it with "deadband"
+const OOPSY_PARAM_DEADBAND = 1/2048
+
 // generate the struct
 function generate_target_struct(target) {
 	
@@ -337,7 +406,7 @@ struct Daisy {	void Init(bool boost = false) {
 		).join("")}
 		${components.filter((e) => e.typename == "daisy::Switch")
 		.map((e, i) => `
-		${e.name}.Init(seed.GetPin(${e.pin}), seed.AudioCallbackRate(), ${e.type}, ${e.polarity}, ${e.pull});`
+		${e.name}.Init(seed.GetPin(${e.pin}), ControlRate(), ${e.type}, ${e.polarity}, ${e.pull});`
 		).join("")}
 		${components.filter((e) => e.typename == "daisy::Switch3").map((e, i) => `
 		${e.name}.Init(seed.GetPin(${e.pin.a}), seed.GetPin(${e.pin.b}));`
@@ -347,7 +416,7 @@ struct Daisy {	void Init(bool boost = false) {
 		${e.name}.Init(&${e.name}_pin);`
 		).join("")}
 		${components.filter((e) => e.typename == "daisy::Encoder").map((e, i) => `
-		${e.name}.Init(seed.GetPin(${e.pin.a}), seed.GetPin(${e.pin.b}), seed.GetPin(${e.pin.click}), seed.AudioCallbackRate());`
+		${e.name}.Init(seed.GetPin(${e.pin.a}), seed.GetPin(${e.pin.b}), seed.GetPin(${e.pin.click}), ControlRate());`
 		).join("")}
 		static const int ANALOG_COUNT = ${
 		components.filter((e) => e.typename == "daisy::AnalogControl").length};
@@ -356,7 +425,7 @@ struct Daisy {	void Init(bool boost = false) {
 		cfg[${i}].InitSingle(seed.GetPin(${e.pin}));`).join("")}
 		seed.adc.Init(cfg, ANALOG_COUNT);
 		${components.filter((e) => e.typename == "daisy::AnalogControl").map((e, i) => `
-		${e.name}.Init(seed.adc.GetPtr(${i}), seed.AudioCallbackRate(), ${e.flip}, ${e.invert});`).join("")}
+		${e.name}.Init(seed.adc.GetPtr(${i}), ControlRate(), ${e.flip}, ${e.invert});`).join("")}
 		${components.filter((e) => e.typename == "daisy::Led").map((e, i) => `
 		${e.name}.Init(seed.GetPin(${e.pin}), ${e.invert});
 		${e.name}.Set(0.0f);`).join("")}	
@@ -409,6 +478,15 @@ struct Daisy {	void Init(bool boost = false) {
 		SetHidUpdateRates();
 	}
 
+	// debounce and filter times are calibrated to how often ProcessAllControls() runs:
+	float ControlRate() {
+		#ifdef OOPSY_CONTROL_TASK
+		return OOPSY_CONTROL_RATE;
+		#else
+		return seed.AudioCallbackRate();
+		#endif
+	}
+
 	void SetHidUpdateRates() {
 		${components.filter((e) => e.updaterate).map((e) => `
 		${template(e.updaterate, e)}`).join("")}
@@ -425,6 +503,9 @@ struct Daisy {	void Init(bool boost = false) {
 
 let watchers = []
 
+// seconds of audio the host bench runs for each samplerate & block size:
+const host_seconds = 10
+
 // the script can be invoked directly as a command-line program,
 // or it can be embedded as a node module
 if (require.main === module) {
@@ -442,10 +523,11 @@ function run() {
 	let cpps = []
 	let samplerate = 48
 	let blocksize = 48
+	// settings given explicitly, for the host bench to sweep:
+	let samplerates = []
+	let blocksizes = []
 	let options = {}
 
-	checkBuildEnvironment();
-	
 	if (args.length == 0) {
 		console.log(help)
 		return;
@@ -458,6 +540,8 @@ function run() {
 			case "gen": action="generate"; break;
 			case "upload":
 			case "up": action="upload"; break;
+			case "host": action="host"; break;
+			case "bench": action="bench"; break;
 
 			case "pod":
 			case "field":
@@ -476,7 +560,7 @@ function run() {
 
 			case "96kHz": 
 			case "48kHz": 
-			case "32kHz": samplerate = +(arg.match(/(\d+)kHz/)[1]); break; 
+			case "32kHz": samplerate = +(arg.match(/(\d+)kHz/)[1]); samplerates.push(samplerate); break; 
 
 			case "block1":
 			case "block2":
@@ -491,14 +575,50 @@ function run() {
 			case "block64": 
 			case "block96": 
 			case "block128":
-			case "block256": blocksize = +(arg.match(/block(\d+)/)[1]); break;
+			case "block256": blocksize = +(arg.match(/block(\d+)/)[1]); blocksizes.push(blocksize); break;
 
 			case "writejson":
 			case "nooled": 
 			case "boost": 
+			case "sd4bit": 
+			case "sdfast": 
+			case "armmath": 
+			case "ftz": 
+			case "snapshot": 
+			case "fixed": 
+			case "sineflash": 
+			case "stealquietest": 
+			case "nosteal": 
+			case "profile": 
+			case "logserial": 
+			case "usbserial": 
 			case "fastmath": options[arg] = true; break;
 
 			default: {
+				// a control task rate, e.g. control1000Hz:
+				let match = arg.match(/^control(\d+)Hz$/)
+				if (match) {
+					options.control_rate = +match[1];
+					break;
+				}
+				// an app switch crossfade, in blocks, e.g. crossfade16:
+				match = arg.match(/^crossfade(\d+)$/)
+				if (match) {
+					options.crossfade_blocks = Math.max(1, +match[1]);
+					break;
+				}
+				// an idle hold time, in ms, e.g. idle2000:
+				match = arg.match(/^idle(\d*)$/)
+				if (match) {
+					options.idle_ms = match[1] ? Math.max(1, +match[1]) : 1000;
+					break;
+				}
+				// polyphony, in voices, e.g. voices8:
+				match = arg.match(/^voices(\d+)$/)
+				if (match) {
+					options.voices = Math.max(1, +match[1]);
+					break;
+				}
 				// assume anything else is a file path:
 				if (!fs.existsSync(arg)) {
 					console.log(`oopsy error: ${arg} is not a recognized argument or a path that does not exist`)
@@ -536,6 +656,22 @@ function run() {
 		return path.basename(a) < path.basename(b) ? -1 : 0;
 	})
 
+	// the host bench has its own target, and doesn't need the ARM toolchain:
+	if (action == "host") {
+		target = "host"
+		target_path = undefined
+		if (!samplerates.length) samplerates = [32, 48, 96]
+		if (!blocksizes.length) blocksizes = [1, 2, 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128, 256]
+		// static buffers must fit the largest block:
+		blocksize = Math.max(...blocksizes)
+	} else {
+		checkBuildEnvironment();
+	}
+	if (action == "bench") {
+		if (!blocksizes.length) blocksizes = [1, 2, 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128, 256]
+		blocksize = Math.max(...blocksizes)
+	}
+
 	let OOPSY_TARGET_SEED = 0
 
 	// configure target:
@@ -586,6 +722,7 @@ function run() {
 								code: template(mapping.get, component),
 								automap: component.automap && name == component.name,
 								range: mapping.range,
+								deadband: mapping.deadband != undefined ? mapping.deadband : component.deadband,
 								where: mapping.where
 							}
 							hardware.labels.params[name] = name
@@ -623,10 +760,16 @@ function run() {
 	hardware.defines.OOPSY_SAMPLERATE = samplerate * 1000
 	hardware.defines.OOPSY_BLOCK_SIZE = blocksize
 	hardware.defines.OOPSY_BLOCK_RATE = hardware.defines.OOPSY_SAMPLERATE / blocksize
+	if (action == "bench") hardware.defines.OOPSY_BENCH = 1
 
 	//hardware.defines.OOPSY_USE_LOGGING = 1
 	//hardware.defines.OOPSY_USE_USB_SERIAL_INPUT = 1
 
+	// (the memory planner needs to know whether each SineData takes RAM)
+	if (options.sineflash) {
+		hardware.defines.GENLIB_SHARED_SINE_TABLE = 1
+	}
+
 	// verify and analyze cpps:
 	assert(cpps.length > 0, "an argument specifying the path to at least one gen~ exported cpp file is required");
 	if (hardware.max_apps && cpps.length > hardware.max_apps) {
@@ -648,6 +791,44 @@ function run() {
 	// ensure build path exists:
 	fs.mkdirSync(build_path, {recursive: true});
 
+	// (the benches run each app at several samplerates and block sizes)
+	const fixed = options.fixed && action != "host" && action != "bench"
+	// an export that uses Oopsy's own [data] or [delay] types, or is fixed to one configuration,
+	// is included via a patched copy in the build path:
+	apps.forEach(app => {
+		let stores = app.patch.datas.filter(data => data.samplesize == 2 || data.planar)
+		let compacts = app.patch.delays.filter(delay => delay.compact)
+		if (!stores.length && !compacts.length && !fixed) return;
+		let cpp = fs.readFileSync(app.path, "utf8")
+		if (fixed) cpp = fix_configuration(cpp)
+		stores.forEach(data => {
+			let type = data.planar ? (data.samplesize == 2 ? "DataPlanar16" : "DataPlanar") : "Data16"
+			cpp = cpp.replace(new RegExp(`\\bData(\\s+${data.cname};)`), `oopsy::${type}$1`)
+		})
+		compacts.forEach(delay => {
+			cpp = cpp.replace(new RegExp(`\\bDelay(\\s+${delay.cname};)`), `oopsy::${delay.compact}$1`)
+		})
+		// keep the export's own #includes working from the build path:
+		cpp = cpp.replace(/#include\s+"([^"]+)"/g, (line, file) => {
+			let file_path = path.join(path.dirname(app.path), file)
+			return fs.existsSync(file_path) ? `#include "${posixify_path(path.relative(build_path, file_path))}"` : line
+		})
+		app.include_path = path.join(build_path, path.basename(app.path))
+		fs.writeFileSync(app.include_path, cpp, "utf-8")
+	})
+
+	// every cycle without a buffer reads the same cosine table, so all apps can share one copy in flash
+	// (but it takes half of the Seed's 128KB of internal flash, so only when asked for):
+	const sine_table_path = path.join(build_path, "genlib_sine_table.h")
+	const sinedatas = apps.reduce((n, app) => n + app.patch.sinedatas, 0)
+	if (sinedatas > 0 && options.sineflash) {
+		fs.writeFileSync(sine_table_path, generate_sine_table(), "utf-8")
+		console.log(`[cycle] ${SINE_TABLE_SIZE * 4 / 1024}KB sine table shared in flash (of 128KB)`)
+	} else {
+		if (sinedatas > 0) console.log(`[cycle] ${sinedatas} sine table(s) of ${SINE_TABLE_SIZE * 4 / 1024}KB each in RAM ("sineflash" would share one in flash)`)
+		delete hardware.defines.GENLIB_SHARED_SINE_TABLE
+	}
+
 	let config = {
 		build_name: build_name,
 		build_path: build_path,
@@ -683,11 +864,67 @@ function run() {
 	if (options.fastmath) {
 		hardware.defines.GENLIB_USE_FASTMATH = 1;
 	}
+	if (options.armmath) {
+		hardware.defines.GENLIB_USE_ARMMATH = 1;
+	}
+	if (options.ftz) {
+		// the FPU flushes denormals to zero (see oopsy::fpu_flush_to_zero), so gen~ needn't test every sample:
+		hardware.defines.GENLIB_NO_DENORM_TEST = 1;
+		hardware.defines.GENLIB_NO_NAN_TEST = 1;
+	}
+	// USB serial is only started when something needs it:
+	if (options.usbserial) {
+		hardware.defines.OOPSY_USE_USB_SERIAL_INPUT = 1;
+	}
+	if (options.profile) {
+		hardware.defines.OOPSY_USE_PROFILER = 1;
+		// without an OLED page, the profile can only be read by "prof" over USB serial:
+		if (!defines.OOPSY_TARGET_HAS_OLED) hardware.defines.OOPSY_USE_USB_SERIAL_INPUT = 1;
+	}
+	if (options.logserial) {
+		hardware.defines.OOPSY_LOG_SERIAL = 1;
+		hardware.defines.OOPSY_USE_USB_SERIAL_INPUT = 1;
+	}
+	if (options.control_rate) {
+		hardware.defines.OOPSY_CONTROL_TASK = 1;
+		hardware.defines.OOPSY_CONTROL_RATE = options.control_rate;
+	}
+	// (the host stand-in for libDaisy has no QSPI flash)
+	if (options.snapshot && action != "host") {
+		hardware.defines.OOPSY_USE_SNAPSHOTS = 1;
+		// without the OLED param tweak, snapshots can only be saved by "save" over USB serial:
+		if (!defines.OOPSY_CAN_PARAM_TWEAK) hardware.defines.OOPSY_USE_USB_SERIAL_INPUT = 1;
+	}
+	// (the benches load each app in turn, and time them alone)
+	if (options.crossfade_blocks && apps.length > 1 && action != "host" && action != "bench") {
+		hardware.defines.OOPSY_CROSSFADE_BLOCKS = options.crossfade_blocks;
+	}
+	if (fixed) {
+		hardware.defines.OOPSY_FIXED_CONFIG = 1;
+	}
+	if (options.voices) {
+		hardware.defines.OOPSY_VOICES = options.voices;
+		if (options.nosteal) {
+			hardware.defines.OOPSY_VOICE_STEAL = "OOPSY_VOICE_STEAL_NONE";
+		} else if (options.stealquietest) {
+			hardware.defines.OOPSY_VOICE_STEAL = "OOPSY_VOICE_STEAL_QUIETEST";
+		}
+	}
+	if (options.idle_ms) {
+		hardware.defines.OOPSY_IDLE_HOLD_MS = options.idle_ms;
+	}
+	if (options.sd4bit) {
+		hardware.defines.OOPSY_SDMMC_BUS_WIDTH = 4;
+	}
+	if (options.sdfast) {
+		hardware.defines.OOPSY_SDMMC_MHZ = 100;
+	}
 
 	const makefile_path = path.join(build_path, `Makefile`)
 	const bin_path = path.join(build_path, "build", build_name+".bin");
 	const maincpp_path = path.join(build_path, `${build_name}_${target}.cpp`);
-	fs.writeFileSync(makefile_path, `
+	// the host build runs the compiler directly, without libDaisy's Makefile:
+	if (action != "host") fs.writeFileSync(makefile_path, `
 # Project Name
 TARGET = ${build_name}
 # Sources -- note, won't work with paths with spaces
@@ -705,13 +942,18 @@ CFLAGS+=-I"${posixify_path(path.relative(build_path, path.join(__dirname, "gen_d
 # Silence irritating warnings:
 CFLAGS+=-O3 -Wno-unused-but-set-variable -Wno-unused-parameter -Wno-unused-variable
 CPPFLAGS+=-O3 -Wno-unused-but-set-variable -Wno-unused-parameter -Wno-unused-variable
+${hardware.defines.GENLIB_USE_ARMMATH ? `# CMSIS-DSP for the armmath option:
+LIBDIR += -L$(LIBDAISY_DIR)/Drivers/CMSIS/DSP/Lib/GCC
+LIBS += -larm_cortexM7lfsp_math`:``}
 
 `, "utf-8");
 
 	console.log(`Will ${action} from ${cpps.join(", ")} by writing to:`)
 	console.log(`\t${maincpp_path}`)
-	console.log(`\t${makefile_path}`)
-	console.log(`\t${bin_path}`)
+	if (action != "host") {
+		console.log(`\t${makefile_path}`)
+		console.log(`\t${bin_path}`)
+	}
 	
 	// add watcher
 	if (watch && watchers.length < 1) {
@@ -752,18 +994,33 @@ ${hardware.inserts.filter(o => o.where == "header").map(o => o.code).join("\n")}
 #include "../genlib_daisy.h"
 #include "../genlib_daisy.cpp"
 
-${apps.map(app => `#include "${posixify_path(path.relative(build_path, app.path))}"`).join("\n")}
+${hardware.defines.GENLIB_USE_ARMMATH ? `// the CMSIS-DSP sin, cos and sqrt, for the exported code:
+${apps.map(app => `namespace ${app.patch.name} { GENLIB_ARMMATH_USING }`).join("\n")}
+` : ""}${apps.map(app => `#include "${posixify_path(path.relative(build_path, app.include_path || app.path))}"`).join("\n")}
+${hardware.defines.GENLIB_SHARED_SINE_TABLE ? `#include "${path.basename(sine_table_path)}"` : ""}
 ${apps.map(app => app.cpp.struct).join("\n")}
 
-// store apps in a union to re-use memory, since only one app is active at once:
+${hardware.defines.OOPSY_CROSSFADE_BLOCKS ? `// store apps in a union to re-use memory; while crossfading, the outgoing and incoming apps are in different slots:
 union {
 	${apps.map(app => app.cpp.union).join("\n\t")}
-} apps;
+} apps[OOPSY_APP_SLOTS];` : `// store apps in a union to re-use memory, since only one app is active at once:
+union {
+	${apps.map(app => app.cpp.union).join("\n\t")}
+} apps;`}
 
 oopsy::AppDef appdefs[] = {
 	${apps.map(app => app.cpp.appdef).join("\n\t")}
 };
 
+${action == "host" ? `
+#include "oopsy_host.h"
+
+int main(void) {
+	static const int rates[] = { ${samplerates.map(rate => rate*1000).join(", ")} };
+	static const int blocks[] = { ${blocksizes.join(", ")} };
+	static oopsy::HostBench bench = { rates, ${samplerates.length}, blocks, ${blocksizes.length}, ${host_seconds}.f };
+	return bench.run(oopsy::daisy, appdefs, ${apps.length});
+}` : `
 int main(void) {
 	#ifdef OOPSY_TARGET_PATCH_SM
 	oopsy::daisy.hardware.Init(); 
@@ -773,14 +1030,32 @@ int main(void) {
 	oopsy::daisy.hardware.SetAudioSampleRate(daisy::SaiHandle::Config::SampleRate::SAI_${hardware.samplerate}KHZ);
 	oopsy::daisy.hardware.SetAudioBlockSize(${hardware.defines.OOPSY_BLOCK_SIZE});
 	${hardware.inserts.filter(o => o.where == "init").map(o => o.code).join("\n\t")}
+	${hardware.defines.OOPSY_CONTROL_TASK ? `// the board class calibrated its controls to the audio callback rate, but they are scanned by the control task:
+	${hardware.inserts.filter(o => o.where == "control_rate").map(o => o.code).join("\n\t")}` : ""}
 	// insert custom hardware initialization here
-	return oopsy::daisy.run(appdefs, ${apps.length});
-}
+	${action == "bench" ? `static const int blocks[] = { ${blocksizes.join(", ")} };
+	return oopsy::daisy.bench(appdefs, ${apps.length}, blocks, ${blocksizes.length});` : `return oopsy::daisy.run(appdefs, ${apps.length});`}
+}`}
 `
 	fs.writeFileSync(maincpp_path, cppcode, "utf-8");	
 
 	console.log("oopsy generated code")
 
+	if (action == "host") {
+		// build with the host compiler against the libDaisy stand-in, and run it:
+		const exe_path = path.join(build_path, build_name)
+		try {
+			console.log("oopsy compiling for host...")
+			execSync(`${process.env.CXX || "c++"} -std=gnu++14 -O3 -DGENLIB_USE_FLOAT32 -Wno-unused-but-set-variable -Wno-unused-parameter -Wno-unused-variable -I"${path.join(__dirname, "host")}" -I"${path.join(__dirname, "gen_dsp")}" "${maincpp_path}" -o "${exe_path}"`, { cwd: build_path, stdio: "inherit" })
+			console.log(`oopsy benchmarking ${host_seconds}s of audio per setting...`)
+			// wav files are looked for next to the (first) cpp:
+			execSync(`"${exe_path}"`, { cwd: path.dirname(cpps[0]), stdio: "inherit" })
+		} catch (e) {
+			console.log("oopsy host build failed", e.message);
+		}
+		return;
+	}
+
 	// now try to make:
 	try {
 		console.log("oopsy compiling...")
@@ -797,7 +1072,7 @@ int main(void) {
 			})
 			console.log(`oopsy created binary ${Math.ceil(fs.statSync(posixify_path(path.join(build_path, "build", build_name+".bin")))["size"]/1024)}KB`)
 			// if successful, try to upload to hardware:
-			if (has_dfu_util && action=="upload") {
+			if (has_dfu_util && (action=="upload" || action=="bench")) {
 				console.log("oopsy flashing...")
 				
 				exec(`make program-dfu`, { cwd: build_path }, (err, stdout, stderr)=>{
@@ -831,7 +1106,7 @@ int main(void) {
 				}
 				console.log(`oopsy created binary ${Math.ceil(fs.statSync(posixify_path(path.join(build_path, "build", build_name+".bin")))["size"]/1024)}KB`)
 				// if successful, try to upload to hardware:
-				if (has_dfu_util && action=="upload") {
+				if (has_dfu_util && (action=="upload" || action=="bench")) {
 					console.log("oopsy flashing...")
 					exec(`export PATH=$PATH:${build_tools_path} && make program-dfu`, { cwd: build_path }, (err, stdout, stderr)=>{
 						console.log("stdout", stdout)
@@ -983,17 +1258,51 @@ function analyze_cpp(cpp, hardware, cpp_path) {
 
 				param.dim = Math.round(args[0])
 				param.chans = Math.round(args[1])
+				param.samplesize = 4
 				gen.datas.push(param)
 
+				// [data foo_int16] is stored as 16-bit integers, in half the memory:
+				let basename = param.name
+				let int16match = /^(\w+)_int16$/g.exec(param.name)
+				if (int16match) {
+					basename = int16match[1]
+					param.samplesize = 2
+				}
+				// [data foo_planar] stores each channel's frames contiguously:
+				let planarmatch = /^(\w+)_planar$/g.exec(basename)
+				if (planarmatch) {
+					basename = planarmatch[1]
+					param.planar = true
+				}
+				// [data foo_snapshot] is saved in the app's snapshot, with the "snapshot" option:
+				let snapshotmatch = /^(\w+)_snapshot$/g.exec(basename)
+				if (snapshotmatch) {
+					basename = snapshotmatch[1]
+					param.snapshot = true
+				}
+
 				let wavname
-				let wavmatch = /(\w+)_wav$/g.exec(param.name)
-				if (wavmatch) {
+				let wavmatch = /(\w+)_wav$/g.exec(basename)
+				let streammatch = /(\w+)_stream$/g.exec(basename)
+				if (streammatch) {
+					// played from the card through a ring buffer of this [data]'s length:
+					wavname = streammatch[1]+".wav";
+					param.stream = true
+					if (param.samplesize != 4) {
+						console.warn(`[data ${param.name}] stream buffers are always 32-bit`)
+						param.samplesize = 4
+					}
+					if (param.planar) {
+						console.warn(`[data ${param.name}] stream buffers are always interleaved`)
+						param.planar = false
+					}
+				} else if (wavmatch) {
 					wavname = wavmatch[1]+".wav";
 				} else {
-					let wavpath = path.join(cpp_path, "..", param.name+".wav")
+					let wavpath = path.join(cpp_path, "..", basename+".wav")
 					if (fs.existsSync(wavpath)) {
 						console.log(`[data ${param.name}] has possible source: ${path.resolve( wavpath )}`)
-						wavname = param.name+".wav";
+						wavname = basename+".wav";
 						//wavpath = path.resolve( wavpath )
 					} 
 				}
@@ -1008,9 +1317,120 @@ function analyze_cpp(cpp, hardware, cpp_path) {
 			}
 		}
 	})
+
+	// find [delay] operators, e.g.
+	// Delay m_delay_5;
+	// m_delay_5.reset("m_delay_5", (samplerate * 2));
+	gen.delays = [];
+	let delaydefinitions = (cpp.match(/\sDelay\s+(\w+);/gm) || []);
+	delaydefinitions.forEach(s => {
+		let cname = /\sDelay\s+(\w+);/.exec(s)[1]
+		let match = new RegExp(`\\s${cname}\\.reset\\("([^"]+)",([^;]+);`, 'gm').exec(cpp)
+		if (match) {
+			let maxdelay = constexpr(match[2].slice(0, -1))
+			assert(typeof maxdelay == "number", `failed to derive length of delay ${cname}`)
+			// a delay named foo_exact is stored at its exact length, and foo_int16 also as 16-bit integers
+			// (oopsy::DelayCompact), rather than rounded up to a power of two:
+			let storagematch = /_(exact|int16)(_\d+)?$/.exec(match[1])
+			gen.delays.push({
+				name: match[1],
+				cname: cname,
+				compact: storagematch ? (storagematch[1] == "int16" ? "Delay16" : "DelayExact") : undefined,
+				dim: storagematch ? Math.max(1, Math.round(maxdelay)) + 1 : next_power_of_two(Math.max(2, Math.round(maxdelay))),
+				chans: 1,
+				samplesize: storagematch && storagematch[1] == "int16" ? 2 : 4,
+			})
+		} else {
+			console.error("failed to match details of delay "+cname)
+		}
+	})
+	gen.sinedatas = (cpp.match(/\sSineData\s+\w+;/gm) || []).length
+	gen.placements = plan_memory(gen, hardware)
 	return gen;
 }
 
+// make the samplerate and vectorsize of an exported State compile-time constants,
+// and run its perform loop for exactly OOPSY_BLOCK_SIZE samples
+function fix_configuration(cpp) {
+	let fixed = cpp
+		.replace(/^(\s*)int vectorsize;/m, "$1static constexpr int vectorsize = OOPSY_BLOCK_SIZE;")
+		.replace(/^(\s*)t_sample samplerate;/m, "$1static constexpr t_sample samplerate = t_sample(OOPSY_SAMPLERATE);")
+		.replace(/^\s*vectorsize = __vs;\n/m, "")
+		.replace(/^\s*samplerate = __sr;\n/m, "")
+		.replace(/^(\s*)vectorsize = __n;/m, "$1__n = vectorsize;")
+		// (C++14 needs a definition of any constexpr member that is bound to a reference)
+		.replace(/^\} State;$/m, "} State;\nconstexpr int State::vectorsize;\nconstexpr t_sample State::samplerate;")
+	if (!/static constexpr int vectorsize/.test(fixed) || !/static constexpr t_sample samplerate/.test(fixed) || !/__n = vectorsize;/.test(fixed)) {
+		console.warn("oopsy warning: couldn't fix the samplerate and block size of this export")
+		return cpp
+	}
+	return fixed
+}
+
+function next_power_of_two(n) {
+	return Math.pow(2, Math.ceil(Math.log2(n)))
+}
+
+// the cosine table that SineData would otherwise compute into RAM, as float literals
+// (9 significant digits round-trip a float exactly); it matches SineData's own cos() (not the fastmath or armmath ones):
+function generate_sine_table() {
+	let lines = []
+	for (let i=0; i<SINE_TABLE_SIZE; i+=8) {
+		let row = []
+		for (let j=i; j<i+8; j++) {
+			// SineData computes i*GENLIB_PI in float before the double math, so round it the same way:
+			row.push(Math.fround(Math.cos(Math.fround(j * Math.fround(Math.PI)) * 2 / SINE_TABLE_SIZE)).toPrecision(9) + "f")
+		}
+		lines.push("\t" + row.join(", ") + ",")
+	}
+	return `// generated by Oopsy: one period of cos(), shared by every SineData
+const t_sample genlib_sine_table[GENLIB_SINE_TABLE_SIZE] = {
+${lines.join("\n")}
+};
+`
+}
+
+// decide which memory region each [data] and [delay] should be allocated in
+// so that placement doesn't depend on the order in which gen~ allocates them
+function plan_memory(gen, hardware) {
+	let objects = gen.delays.map(o => ({
+		kind: "delay",
+		name: o.name, 
+		bytes: o.dim * o.samplesize,
+		hot: o.dim * o.samplesize <= OOPSY_HOT_DELAY_BYTES,
+	})).concat(gen.datas.map(o => ({
+		kind: "data",
+		name: o.name, 
+		bytes: o.dim * o.chans * o.samplesize,
+		// sample files can be shared via the sample cache:
+		wavname: o.stream ? undefined : o.wavname,
+		planar: o.planar && o.chans > 1,
+		// stream rings are read sequentially every sample, like a delay line:
+		hot: o.stream ? o.dim * o.chans * 4 <= OOPSY_HOT_DELAY_BYTES : !o.wavname && o.dim * o.chans * o.samplesize <= OOPSY_HOT_DATA_BYTES,
+	})))
+	// half of DTCM is left for the gen~ State object itself
+	let dtcm_budget = OOPSY_DTCM_SIZE / 2
+	// leave SRAM for the 64KB table that every SineData allocates (unless they share one in flash), plus some slack
+	let sram_budget = OOPSY_SRAM_SIZE - (hardware.defines.GENLIB_SHARED_SINE_TABLE ? 0 : gen.sinedatas * SINE_TABLE_SIZE * 4) - 32 * 1024
+	// smallest hot objects get the fastest memory:
+	objects.filter(o => o.hot).sort((a, b) => a.bytes - b.bytes).forEach(o => {
+		if (o.bytes <= dtcm_budget) {
+			o.region = "REGION_DTCM"
+			dtcm_budget -= o.bytes
+		} else if (o.bytes <= sram_budget) {
+			o.region = "REGION_SRAM"
+			sram_budget -= o.bytes
+		} else {
+			o.region = "REGION_SDRAM"
+		}
+	})
+	objects.filter(o => !o.hot).forEach(o => o.region = "REGION_SDRAM")
+	objects.forEach(o => {
+		console.log(`[${o.kind} ${o.name}] ${Math.ceil(o.bytes/1024)}KB ${o.hot ? "hot" : "cold"}, placed in ${o.region.replace("REGION_", "").toLowerCase()}`)
+	})
+	return objects
+}
+
 function generate_daisy(hardware, nodes) {
 	let daisy = {
 		// DEVICE INPUTS:
@@ -1100,11 +1520,20 @@ function generate_app(app, hardware, target, config) {
 	app.has_generic_midi_in = false
 	app.has_midi_out = false
 	app.midi_out_count = 0;
+	// continuous MIDI outputs each get a slot that holds their latest unsent message:
+	app.midi_out_slots = 0;
 	app.nodes = nodes;
 	app.daisy = daisy;
 	app.gen = gen;
 	app.nodes = nodes;
 	app.inserts = [];
+	// with the voices option, a patcher with voice_* params is a voice kernel, performed once per sounding voice:
+	const voiced = !!defines.OOPSY_VOICES && app.patch.params.some(param => /^voice_(pitch|vel|gate)$/.test(param.name))
+	app.voiced = voiced
+	if (voiced) {
+		app.has_midi_in = true;
+		if (!defines.OOPSY_TARGET_HAS_MIDI_INPUT) console.warn(`oopsy warning: ${name} has voices, but the ${target} has no MIDI input to play them`)
+	}
 
 	gen.audio_ins = app.patch.ins.map((s, i)=>{
 		let name = "gen_in"+(i+1)
@@ -1134,32 +1563,14 @@ function generate_app(app, hardware, target, config) {
 	})
 
 
+	// each gen~ out is assigned a buffer to perform into:
+	// - an audio out writes straight into the hardware output of the same index
+	// - an out mapped to a CV/gate/MIDI output needs a buffer of its own to read afterward:
+	//   the hardware output of the same index (which is then filled by the pass below), else a glue buffer
+	// - an out that goes nowhere writes into the shared daisy.discard_buffer
 	gen.audio_outs = app.patch.outs.map((s, i)=>{
 		let name = "gen_out"+(i+1)
 		let label = s.replace(/"/g, "").trim();
-		let src = daisy.audio_outs[i];
-		if (!src) {
-			// create a glue node buffer for this:
-			src = `glue_out${i+1}`
-			nodes[src] = {
-				// name: name,
-				// kind: "output_buffer",
-				// index: i,
-				//label: s,
-				to: [],
-			}
-			app.audio_outs.push(src);
-		}
-		
-		let node = {
-			name: name,
-			// label: label,
-			// index: i,
-			src: src,
-		}
-		nodes[name] = node
-
-		// figure out if the out buffer maps to anything:
 
 		// search for a matching [out] name / prefix:
 		let map
@@ -1172,17 +1583,29 @@ function generate_app(app, hardware, target, config) {
 			}
 		})
 
-		if (map) {
-			label = maplabel
-		} else {
-			// else it is audio data			
-			nodes[src].src = src;
+		let src = daisy.audio_outs[i];
+		if (!src && map) {
+			// create a glue node buffer for this:
+			src = `glue_out${i+1}`
+			nodes[src] = {
+				to: [],
+			}
+			app.audio_outs.push(src);
+		} else if (!src) {
+			src = "daisy.discard_buffer"
+		}
+		nodes[name] = {
+			name: name,
+			src: src,
+			label: map ? maplabel : label,
 		}
-		nodes[name].label = label
-		// was this out mapped to something?
 		if (map) {
+			// was this out mapped to something?
 			nodes[map].from.push(src);
 			nodes[src].to.push(map)
+		} else if (nodes[src]) {
+			// else it is audio data, in place:
+			nodes[src].src = src;
 		}
 		return name;
 	})
@@ -1221,18 +1644,14 @@ function generate_app(app, hardware, target, config) {
 				if (node.midi_type == "cc") {
 					app.has_midi_out = true;
 					let statusbyte = 176+((node.midi_chan)-1)%16;
-					node.setter = `daisy.midi_message3(${statusbyte}, ${(node.midi_num)%128}, ((uint8_t)(${node.varname}*127.f)) & 0x7F);`; 
+					node.setter = `daisy.midi_coalesce(${app.midi_out_slots++}, ${statusbyte}, ${(node.midi_num)%128}, ((uint8_t)(${node.varname}*127.f)) & 0x7F);`; 
 					node.type = "float";
-					node.midi_throttle = true;
-					node.midi_only_when_changed = true;
 					nodes[name] = node
 				} else if (node.midi_type == "press") {
 					app.has_midi_out = true;
 					let statusbyte = 208+((node.midi_chan)-1)%16;
-					node.setter = `daisy.midi_message2(${statusbyte}, ((uint8_t)(${node.varname}*127.f)) & 0x7F);`; 
+					node.setter = `daisy.midi_coalesce(${app.midi_out_slots++}, ${statusbyte}, ((uint8_t)(${node.varname}*127.f)) & 0x7F);`; 
 					node.type = "float";
-					node.midi_throttle = true;
-					node.midi_only_when_changed = true;
 					nodes[name] = node;
 				} else if (node.midi_type == "bend") {
 					app.has_midi_out = true;
@@ -1240,10 +1659,8 @@ function generate_app(app, hardware, target, config) {
 					let float = `((${node.varname}+1.f)*64.f)`;
 					let lsb = `((uint8_t)(${float}*128.f)) & 0x7F`;
 					let msb = `((uint8_t)${float}) & 0x7F`;
-					node.setter = `daisy.midi_message3(${statusbyte}, ${lsb}, ${msb});`; 
+					node.setter = `daisy.midi_coalesce(${app.midi_out_slots++}, ${statusbyte}, ${lsb}, ${msb});`; 
 					node.type = "float";
-					node.midi_throttle = true;
-					node.midi_only_when_changed = true;
 					nodes[name] = node;
 				} else if (node.midi_type == "program") {
 					app.has_midi_out = true;
@@ -1326,6 +1743,13 @@ function generate_app(app, hardware, target, config) {
 		node.range = node.max - node.min;
 
 		let match
+		// the note of a voice, set by the voice allocator:
+		if (voiced && (match = (/^voice_(pitch|vel|gate)$/g).exec(param.name))) {
+			node.where = "voice"
+			node.voice = match[1]
+			// need to set "src" to something to prevent this being automapped
+			src = node.where
+		} else
 		// check for dedicated midi patterns:
 		// e.g.
 		// [param midi_cc100_ch1] // input is 0..1 for cc value
@@ -1410,6 +1834,13 @@ function generate_app(app, hardware, target, config) {
 				where: "post_audio",
 				code: `${node.varname} = 0.f;`
 			})
+		} else if ((match = (/^(\w+)_loaded$/g).exec(param.name)) 
+			&& (match = app.patch.datas.find(data => data.name == match[1] && data.wavname && !data.stream))) {
+			// [param foo_loaded] reports how many frames of [data foo] have been loaded from the SD card so far
+			node.where = "wav_loaded"
+			// need to set "src" to something to prevent this being automapped
+			src = node.where
+			node.code = `${node.varname} = daisy.sdcard_wav_loaded(&gen.${match.cname});`
 		} else {
 			// search for a matching [out] name / prefix:
 			Object.keys(hardware.labels.params).sort().forEach(k => {
@@ -1516,6 +1947,7 @@ function generate_app(app, hardware, target, config) {
 	})
 
 	// normal any audio outs from earlier (non cv/gate/midi) audio outs
+	// (a true fan-out, so these are the only copies; outputs with no source are zeroed)
 	{
 		let available = []
 		daisy.audio_outs.forEach((name, i)=>{
@@ -1529,12 +1961,49 @@ function generate_app(app, hardware, target, config) {
 		});
 	}
 
+	app.midi_noteouts.filter(note=>note.press).forEach(note => note.midi_slot = app.midi_out_slots++)
+	// genlib_daisy.h has 32 slots unless told otherwise:
+	if (app.midi_out_slots > 32) {
+		hardware.defines.OOPSY_MIDI_OUT_SLOTS = Math.max(hardware.defines.OOPSY_MIDI_OUT_SLOTS || 0, app.midi_out_slots)
+	}
+
+	// with a control task, the hardware inputs are read (and switches debounced) there,
+	// and the audio callback only reads the last snapshot:
+	const control_task = hardware.defines.OOPSY_CONTROL_TASK
+	const control_inputs = daisy.device_inputs.map(name => nodes[name]).filter(node => node.to.length)
+	const control_inserts = control_task ? hardware.inserts.filter(o => o.where == "audio") : []
+	const audio_inserts = app.inserts.concat(hardware.inserts).filter(o => o.where == "audio" && !control_inserts.includes(o))
+
+	// a polyphonic app sets its params on every voice:
+	const set_param = (node, value) => voiced 
+		? `for (int v=0; v<OOPSY_VOICES; v++) voice_states[v]->set_${node.name}(${value});` 
+		: `gen.set_${node.name}(${value});`
+	const voice_param = which => gen.params.map(name=>nodes[name]).find(node => node.voice == which)
+	const voice_pitch = voice_param("pitch"), voice_vel = voice_param("vel"), voice_gate = voice_param("gate")
+	// [history voice_level_out] reports a voice's envelope, else its output level decides when it has fallen silent:
+	const voice_level = app.patch.histories.find(history => history.name == "voice_level")
+	const outcount = gen.audio_outs.length
+	// with the idle option, an app that has fallen silent skips perform until something wakes it:
+	const idle = !!defines.OOPSY_IDLE_HOLD_MS
+	const idle_hold = gen.params.map(name=>nodes[name]).find(node => node.name == "idle_hold")
+	const idle_ins = gen.audio_ins.map(name=>nodes[name].src).filter(src => src)
+	const zero_fill = buf => hardware.defines.GENLIB_USE_ARMMATH ? `arm_fill_f32(0.f, ${buf}, size);` : `memset(${buf}, 0, sizeof(float)*size);`
+	// the voices that are sounding perform into their own buffers, which are summed into the outputs:
+	const perform = voiced ? `float * voice_outputs[] = { ${gen.audio_outs.map((name, i)=>`voice_buffers[${i}]`).join(", ")} };
+		for (int i=0; i<${outcount}; i++) ${zero_fill(`outputs[i]`)}
+		for (int v=0; v<OOPSY_VOICES; v++) {
+			if (!voices.sounding(v)) continue;
+			voice_states[v]->perform(inputs, voice_outputs, size);
+			float peak = oopsy::voice_mix(voice_outputs, outputs, ${outcount}, size);
+			voices.performed(v, ${voice_level ? `fabsf(voice_states[v]->${voice_level.cname})` : `peak`}, size);
+		}` : `gen.perform(inputs, outputs, size);`
+
 	const struct = `
 
 struct App_${name} : public oopsy::App<App_${name}> {
 	${gen.params
 		.map(name=>`
-	${nodes[name].type} ${name};`).join("")}
+	${nodes[name].type} ${name}, ${name}_sent;`).join("")}
 	${app.midi_noteouts.map(note=>`
 	oopsy::GenDaisy::MidiNote ${note.cname};`).join("")}
 	${gen.histories.map(name=>nodes[name]).filter(node => node && node.midi_type).map(node=>`
@@ -1547,20 +2016,53 @@ struct App_${name} : public oopsy::App<App_${name}> {
 	float ${node.name};`).join("")}
 	${app.audio_outs.map(name=>`
 	float ${name}[OOPSY_BLOCK_SIZE];`).join("")}
+	${voiced ? `
+	${name}::State * voice_states[OOPSY_VOICES];
+	oopsy::VoiceAllocator<OOPSY_VOICES> voices;
+	float voice_buffers[${outcount}][OOPSY_BLOCK_SIZE];` : ''}
+	${idle ? `
+	oopsy::IdleDetect idle;` : ''}
+	${control_task ? `
+	struct Controls {${control_inputs.map(node=>`
+		float ${node.name};`).join("")}
+	};
+	oopsy::DoubleBuffer<Controls> controls;` : ''}
 	
 	void init(oopsy::GenDaisy& daisy) {
+		${app.patch.placements.length ? `static const oopsy::Placement placements[] = {${app.patch.placements.map(o=>`
+			{ "${o.name}", oopsy::${o.region}${o.wavname ? `, "${o.wavname}"${o.planar ? `, true` : ""}` : ""} }, // ${o.kind}, ${Math.ceil(o.bytes/1024)}KB`).join("")}
+		};
+		oopsy::set_placements(placements, ${app.patch.placements.length});` : `oopsy::set_placements(nullptr, 0);`}
+		// small state (histories, coefficients etc.) goes in the fastest region it fits,
+		// and anything that create() allocates that isn't in the plan goes in SRAM:
+		const oopsy::Region state_region = (${voiced ? `OOPSY_VOICES * ` : ``}sizeof(${name}::State) <= OOPSY_DTCM_SIZE/2) ? oopsy::REGION_DTCM : oopsy::REGION_SRAM;
+		oopsy::placement = oopsy::REGION_SRAM;
+		${voiced ? `for (int v=0; v<OOPSY_VOICES; v++) {
+			oopsy::place_next(sizeof(${name}::State), state_region);
+			#ifdef OOPSY_TARGET_PATCH_SM
+			voice_states[v] = (${name}::State *)${name}::create(daisy.hardware.AudioSampleRate(), daisy.hardware.AudioBlockSize());
+			#else
+			voice_states[v] = (${name}::State *)${name}::create(daisy.hardware.seed.AudioSampleRate(), daisy.hardware.seed.AudioBlockSize());
+			#endif
+		}
+		// the first voice stands in for the app's gen~ (for its outputs, wav loads, snapshots etc.):
+		daisy.gen = voice_states[0];
+		voices.reset();` : `oopsy::place_next(sizeof(${name}::State), state_region);
 		#ifdef OOPSY_TARGET_PATCH_SM
 		daisy.gen = ${name}::create(daisy.hardware.AudioSampleRate(), daisy.hardware.AudioBlockSize());
 		#else
 		daisy.gen = ${name}::create(daisy.hardware.seed.AudioSampleRate(), daisy.hardware.seed.AudioBlockSize());
-		#endif
+		#endif`}
 		${name}::State& gen = *(${name}::State *)daisy.gen;
 		
 		daisy.param_count = ${gen.params.length};
+		${defines.OOPSY_TARGET_USES_MIDI_UART ? `daisy.midi_thru = ${app.has_generic_midi_thru ? "true" : "false"};` : ``}
 		${(defines.OOPSY_HAS_PARAM_VIEW) ? `daisy.param_selected = ${Math.max(0, gen.params.map(name=>nodes[name].src).indexOf(undefined))};`:``}
 		${gen.params.map(name=>nodes[name])
 			.map(node=>`
-		${node.varname} = ${asCppNumber(node.default, node.type)};`).join("")}
+		${node.varname} = ${asCppNumber(node.default, node.type)};
+		${set_param(node, `${node.varname}_sent = ${node.varname}`)}`).join("")}
+		${idle ? `idle.reset((uint32_t)(gen.samplerate * ${idle_hold ? idle_hold.varname : asCppNumber(defines.OOPSY_IDLE_HOLD_MS * 0.001)}));` : ''}
 		${daisy.device_outs.map(name => nodes[name])
 			.filter(node => node.src || node.from.length)
 			.map(node=>`
@@ -1572,35 +2074,123 @@ struct App_${name} : public oopsy::App<App_${name}> {
 			.filter(node => node.data)
 			.map(node =>`
 		${interpolate(node.init, node)};`).join("")}
+		${defines.OOPSY_USE_SNAPSHOTS ? `// the last saved params and tables, if the patch hasn't changed since:
+		daisy.snapshot_begin(${name}::getstatesize, ${name}::getstate, ${name}::setstate);${app.patch.datas.filter(o => o.snapshot).map(o=>`
+		daisy.snapshot_table(gen.${o.cname}.mData, gen.${o.cname}.dim * gen.${o.cname}.channels * sizeof(*gen.${o.cname}.mData));`).join("")}
+		if (daisy.snapshot_restore()) {${gen.params.map(name=>nodes[name]).map(node=>voiced ? (node.where == "voice" ? `` : `
+			${node.varname} = (${node.type})gen.${node.cname}; // (sent to every voice in the next block)`) : `
+			${node.varname} = ${node.varname}_sent = (${node.type})gen.${node.cname};`).join("")}
+		}` : ''}
 		${gen.datas.map(name=>nodes[name])
 			.filter(node => node.wavname)
-			.map(node=>`
-		daisy.sdcard_load_wav("${node.wavname}", gen.${node.cname});`).join("")}
+			.map(node=>(voiced && !node.stream) ? `
+		for (int v=0; v<OOPSY_VOICES; v++) daisy.sdcard_queue_wav("${node.wavname}", voice_states[v]->${node.cname});` : `
+		daisy.${node.stream ? "sdcard_stream_wav" : "sdcard_queue_wav"}("${node.wavname}", gen.${node.cname});`).join("")}
+		${control_task ? `// a first snapshot, for the first block:
+		controls.reset();
+		controlCallback(daisy);` : ''}
 	}
-
-	void audioCallback(oopsy::GenDaisy& daisy, daisy::AudioHandle::InputBuffer hardware_ins, daisy::AudioHandle::OutputBuffer hardware_outs, size_t size) {
+	${control_task ? `
+	void controlCallback(oopsy::GenDaisy& daisy) {
 		Daisy& hardware = daisy.hardware;
-		${name}::State& gen = *(${name}::State *)daisy.gen;
-		${app.inserts.concat(hardware.inserts).filter(o => o.where == "audio").map(o => o.code).join("\n\t")}
-		${daisy.device_inputs.map(name => nodes[name])
-			.filter(node => node.to.length)
+		${control_inserts.map(o => o.code).join("\n\t\t")}
+		${control_inputs
 			.filter(node => node.update && node.update.where == "audio")
 			.map(node=>`
 		${interpolate(node.update.code, node)};`).join("")}
-		${daisy.device_inputs.map(name => nodes[name])
-			.filter(node => node.to.length)
+		Controls& snapshot = controls.back();
+		${control_inputs.map(node=>`
+		snapshot.${node.name} = ${node.code};`).join("")}
+		controls.publish();
+	}
+	` : ''}
+	void audioCallback(oopsy::GenDaisy& daisy, daisy::AudioHandle::InputBuffer hardware_ins, daisy::AudioHandle::OutputBuffer hardware_outs, size_t ${defines.OOPSY_FIXED_CONFIG ? `` : `size`}) {
+		${defines.OOPSY_FIXED_CONFIG ? `// the hardware block size is set to this in main():
+		constexpr size_t size = OOPSY_BLOCK_SIZE;
+		` : ``}Daisy& hardware = daisy.hardware;
+		${name}::State& gen = *(${name}::State *)daisy.gen;
+		${audio_inserts.map(o => o.code).join("\n\t")}
+		${defines.OOPSY_TARGET_USES_MIDI_UART ? `
+		// MIDI received during the last block, at the sample offsets it arrived at:
+		uint8_t byte;
+		size_t offset;${idle ? `
+		bool midi_received = false;` : ``}${voiced && voice_gate ? `
+		// a voice that got a new note while still held has had a block with its gate down, so raise it again:
+		for (int v=0; v<OOPSY_VOICES; v++) {
+			if (!voices.voices[v].retrigger) continue;
+			voices.voices[v].retrigger = false;
+			if (voices.voices[v].held) voice_states[v]->set_voice_gate(${voice_gate.varname} = ${voice_gate.varname}_sent = 1.f);
+		}` : ``}
+		while (daisy.midi_in_pop(byte, offset)) {${idle ? `
+			midi_received = true;` : ``}
+			if (byte >= 128) { // status byte
+				${gen.params
+				.map(name=>nodes[name])
+				.filter(node => node.where == "midi_status")
+				.map(node=>node.code)
+				.concat(`if (byte <= 240 || byte == 247) {
+					daisy.midi.status = byte; 
+					daisy.midi.lastbyte = 255; // means 'no bytes received'
+				}`)
+				.join(" else ")}
+			} else {
+				daisy.midi.lastbyte = !daisy.midi.lastbyte; 
+				daisy.midi.byte[daisy.midi.lastbyte] = byte;
+				${voiced ? `if (daisy.midi.lastbyte == 1 && (daisy.midi.status/16 == 8 || daisy.midi.status/16 == 9)) {
+					uint8_t note = daisy.midi.byte[0], vel = daisy.midi.byte[1], chan = daisy.midi.status % 16;
+					// (a note on with velocity 0 is a note off)
+					if (daisy.midi.status/16 == 9 && vel) {
+						int v = voices.note_on(note, chan);
+						if (v >= 0) voice_on(*voice_states[v], note, vel, voices.voices[v].retrigger);
+					} else {
+						int v = voices.note_off(note, chan);
+						if (v >= 0) voice_off(*voice_states[v]);
+					}
+				} else if (daisy.midi.lastbyte == 1 && daisy.midi.status/16 == 11 && (daisy.midi.byte[0] == 120 || daisy.midi.byte[0] == 123)) {
+					// all sound off, all notes off:
+					for (int v=0; v<OOPSY_VOICES; v++) {
+						if (voices.release(v)) voice_off(*voice_states[v]);
+					}
+				}
+				` : ``}				${gen.params
+					.map(name=>nodes[name])
+					.filter(node => node.where == "midi_msg")
+					.map(node=>node.code)
+					.join(" else ")}
+			}
+			${app.has_generic_midi_in ? `
+			daisy.midi_in_write(byte, offset, size);` : ""}
+			daisy.midi_in_active = 1;
+		}` : "// no midi input handling"}
+		${control_task ? `const Controls& snapshot = controls.read();${control_inputs.map(node=>`
+		float ${node.name} = snapshot.${node.name};`).join("")}` : `${control_inputs
+			.filter(node => node.update && node.update.where == "audio")
 			.map(node=>`
-		float ${node.name} = ${node.code};`).join("")}
+		${interpolate(node.update.code, node)};`).join("")}
+		${control_inputs.map(node=>`
+		float ${node.name} = ${node.code};`).join("")}`}
 		${gen.params
 			.map(name=>nodes[name])
 			.filter(node => node.src)
 			.filter(node => node.where == "audio" || node.where == undefined)
+			.map(node=>(node.type == "int" || node.type == "bool") ? `
+		${node.varname} = (${node.type})(${node.src}*${asCppNumber(node.range)} + ${asCppNumber(node.min + 0.5)});` : `
+		${param_deadband_update(node, nodes[node.src])}`).join("")}
+		${gen.params
+			.map(name=>nodes[name])
+			.filter(node => node.where == "wav_loaded")
 			.map(node=>`
-		${node.varname} = (${node.type})(${node.src}*${asCppNumber(node.range)} + ${asCppNumber(node.min + (node.type == "int" || node.type == "bool" ? 0.5 : 0))});`).join("")}
+		${node.code}`).join("")}
+		// only pass on params that changed:
+		int params_changed = 0;
 		${gen.params
 			.map(name=>nodes[name])
+			.filter(node => node.where != "voice")
 			.map(node=>`
-		gen.set_${node.name}(${node.varname});`).join("")}
+		if (${node.varname} != ${node.varname}_sent) { ${set_param(node, `${node.varname}_sent = ${node.varname}`)} params_changed++; }`).join("")}
+		if (params_changed) {
+			${app.inserts.concat(hardware.inserts).filter(o => o.where == "params_changed").map(o => o.code).join("\n\t\t\t")}
+		}
 		${daisy.audio_ins.map((name, i)=>`
 		float * ${name} = (float *)hardware_ins[${i}];`).join("")}
 		${daisy.audio_outs.map((name, i)=>`
@@ -1608,10 +2198,23 @@ struct App_${name} : public oopsy::App<App_${name}> {
 		${app.has_midi_in ? daisy.midi_ins.map(name=>`
 		float * ${name} = daisy.midi_in_data;`).join("") : ''}
 		// ${gen.audio_ins.map(name=>nodes[name].label).join(", ")}:
-		float * inputs[] = { ${gen.audio_ins.map(name=>nodes[name].src).join(", ")} }; 
+		float * inputs[] = { ${gen.audio_ins.map(name=>nodes[name].src || "daisy.zero_buffer").join(", ")} }; 
 		// ${gen.audio_outs.map(name=>nodes[name].label).join(", ")}:
 		float * outputs[] = { ${gen.audio_outs.map(name=>nodes[name].src).join(", ")} };
-		gen.perform(inputs, outputs, size);
+		${hardware.defines.OOPSY_USE_PROFILER ? `daisy.profiler.lap(oopsy::PROFILE_CONTROLS);` : ''}
+		${idle ? `${idle_hold ? `idle.hold = (uint32_t)(gen.samplerate * ${idle_hold.varname});
+		` : ``}// any input, MIDI or param change wakes an idle app:
+		${idle_ins.length ? `float * idle_inputs[] = { ${idle_ins.join(", ")} };
+		` : ``}bool woken = params_changed${defines.OOPSY_TARGET_USES_MIDI_UART ? ` || midi_received` : ``}${idle_ins.length ? `
+			|| oopsy::block_peak(idle_inputs, ${idle_ins.length}, size) >= OOPSY_IDLE_SILENCE` : ``};
+		if (idle.skip(woken)) {
+			for (int i=0; i<${outcount}; i++) ${zero_fill(`outputs[i]`)}${hardware.defines.OOPSY_USE_PROFILER ? `
+			daisy.profiler.idle++;` : ``}
+		} else {
+			${perform.replace(/\n/g, "\n\t")}
+			idle.performed(oopsy::block_peak(outputs, ${outcount}, size), size);
+		}` : perform}
+		${hardware.defines.OOPSY_USE_PROFILER ? `daisy.profiler.lap(oopsy::PROFILE_PERFORM);` : ''}
 		${daisy.device_outs.map(name => nodes[name])
 			.filter(node => node.src || node.from.length)
 			.map(node => node.src ? `
@@ -1628,7 +2231,6 @@ struct App_${name} : public oopsy::App<App_${name}> {
 			.map(node =>`
 		${interpolate(node.code, node)} // data out`).join("")}
 		${app.midi_outs
-			.filter(node=>!node.midi_throttle)
 			.map(node=>`
 		if (${node.varname} != (${node.type})${node.setter_src}) {
 			${node.varname} = ${node.setter_src};
@@ -1641,35 +2243,38 @@ struct App_${name} : public oopsy::App<App_${name}> {
 			((uint8_t)(gen.${note.vel.cname}*127.f)) & 0x7F, 
 			((uint8_t)gen.${note.pitch.cname}) & 0x7F, 
 			${note.chan ? `((uint8_t)(gen.${note.chan.cname})-1) % 16` : "0"});`).join("")}
-		// msgs: ${(app.midi_outs.filter(node=>node.midi_throttle).length + app.midi_noteouts.filter(note=>note.press).length)}
-		// rate: ${hardware.defines.OOPSY_BLOCK_RATE/500}
-		${(app.midi_outs.filter(node=>node.midi_throttle).length + app.midi_noteouts.filter(note=>note.press).length) > 0 ? `
-		if (daisy.blockcount % ${ Math.ceil((app.midi_outs.filter(node=>node.midi_throttle).length + app.midi_noteouts
-			.filter(note=>note.press).length) * hardware.defines.OOPSY_BLOCK_RATE/500)} == 0){ // throttle output for MIDI baud limits
-			${app.midi_outs
-				.filter(node=>node.midi_throttle)
-				.map(node=>`
-			${node.midi_only_when_changed ? `if (${node.varname} != (${node.type})${node.setter_src}) {` : `{`}
-				${node.varname} = ${node.setter_src};
-				${node.setter}
-			}`).join("")}
-			${app.midi_noteouts
-				.filter(note=>note.press)
-				.map(note=>`
-			${note.cname}.update_pressure(daisy, ((uint8_t)gen.${note.press.cname}) & 0x7F);`).join("")}
-		}` : ''}
+		${app.midi_noteouts
+			.filter(note=>note.press)
+			.map(note=>`
+		${note.cname}.update_pressure(daisy, ${note.midi_slot}, ((uint8_t)gen.${note.press.cname}) & 0x7F);`).join("")}
 		${app.has_midi_out ? daisy.midi_outs.map(name=>nodes[name].from.map(name=>`
 		daisy.midi_postperform(${name}, size);`).join("")).join("") : ''}
 		${daisy.audio_outs.map(name=>nodes[name])
 			.filter(node => node.src != node.name)
-			.map(node=>node.src ? `
-		memcpy(${node.name}, ${node.src}, sizeof(float)*size);` : `
-		memset(${node.name}, 0, sizeof(float)*size);`).join("")}
+			.map(node=>node.src ? (hardware.defines.GENLIB_USE_ARMMATH ? `
+		arm_copy_f32(${node.src}, ${node.name}, size);` : `
+		memcpy(${node.name}, ${node.src}, sizeof(float)*size);`) : (hardware.defines.GENLIB_USE_ARMMATH ? `
+		arm_fill_f32(0.f, ${node.name}, size);` : `
+		memset(${node.name}, 0, sizeof(float)*size);`)).join("")}
 		${app.inserts.concat(hardware.inserts).filter(o => o.where == "post_audio").map(o => o.code).join("\n\t")}
 		${hardware.defines.OOPSY_TARGET_SEED ? "hardware.PostProcess();" : ""}
 	}	
 
-	void mainloopCallback(oopsy::GenDaisy& daisy, uint32_t t, uint32_t dt) {
+	${voiced ? `// a voice starts a note (perhaps taking it from another);
+	// if it was still held, its gate drops for this block, and rises at the next one:
+	void voice_on(${name}::State& voice, uint8_t note, uint8_t vel, bool retrigger) {${voice_pitch ? `
+		voice.set_voice_pitch(${voice_pitch.varname} = ${voice_pitch.varname}_sent = note);` : ``}${voice_vel ? `
+		voice.set_voice_vel(${voice_vel.varname} = ${voice_vel.varname}_sent = (vel/127.f)*${asCppNumber(voice_vel.range)} + ${asCppNumber(voice_vel.min)});` : ``}${voice_gate ? `
+		voice.set_voice_gate(${voice_gate.varname} = ${voice_gate.varname}_sent = retrigger ? 0.f : 1.f);` : ``}
+	}
+
+	// the note is released, and the voice sounds on until it falls silent:
+	void voice_off(${name}::State& voice) {${voice_gate ? `
+		voice.set_voice_gate(${voice_gate.varname} = ${voice_gate.varname}_sent = 0.f);` : voice_vel ? `
+		voice.set_voice_vel(${voice_vel.varname} = ${voice_vel.varname}_sent = ${asCppNumber(voice_vel.min)});` : ``}
+	}
+
+	` : ``}void mainloopCallback(oopsy::GenDaisy& daisy, uint32_t t, uint32_t dt) {
 		Daisy& hardware = daisy.hardware;
 		${name}::State& gen = *(${name}::State *)daisy.gen;
 		${app.inserts.concat(hardware.inserts).filter(o => o.where == "main").map(o => o.code).join("\n\t")}
@@ -1683,45 +2288,6 @@ struct App_${name} : public oopsy::App<App_${name}> {
 			.filter(node => node.config.where == "main")
 			.map(node=>`
 		${interpolate(node.config.code, node)}`).join("")}
-		${defines.OOPSY_TARGET_USES_MIDI_UART ? `
-		while(daisy.uart.Readable()) {
-			uint8_t byte = daisy.uart.PopRx();
-			if (byte >= 128) { // status byte
-				${gen.params
-				.map(name=>nodes[name])
-				.filter(node => node.where == "midi_status")
-				.map(node=>node.code)
-				.concat(`if (byte == 0xFF) { // reset event -> go to bootloader
-					daisy.log("reboot");
-					daisy::System::ResetToBootloader();
-				} 
-				if (byte <= 240 || byte == 247) {
-					daisy.midi.status = byte; 
-					daisy.midi.lastbyte = 255; // means 'no bytes received'
-				}`)
-				.join(" else ")}
-			} else {
-				daisy.midi.lastbyte = !daisy.midi.lastbyte; 
-				daisy.midi.byte[daisy.midi.lastbyte] = byte;
-				${gen.params
-					.map(name=>nodes[name])
-					.filter(node => node.where == "midi_msg")
-					.map(node=>node.code)
-					.concat(defines.OOPSY_MULTI_APP ? `
-					if (daisy.midi.status/16 == 12) { // program change -> app change
-						daisy.schedule_app_load(daisy.midi.byte[daisy.midi.lastbyte]);
-					}`:[])
-					.join(" else ")}
-			}
-			${app.has_generic_midi_in ? `
-			${app.has_generic_midi_thru ? `daisy.midi_message1(byte); // thru` : ``}
-			if (daisy.midi_in_written < OOPSY_BLOCK_SIZE) {
-				// scale (0, 255) to (0.0, 1.0) to protect hardware from accidental patching
-				daisy.midi_in_data[daisy.midi_in_written] = byte / 256.0f;
-				daisy.midi_in_written++;
-			}` : ""}
-			daisy.midi_in_active = 1;
-		}` : "// no midi input handling"}
 	}
 
 	void displayCallback(oopsy::GenDaisy& daisy, uint32_t t, uint32_t dt) {
@@ -1770,7 +2336,9 @@ struct App_${name} : public oopsy::App<App_${name}> {
 };`
 	app.cpp = {
 		union: `App_${name} app_${name};`,
-		appdef: `{"${name}", []()->void { oopsy::daisy.reset(apps.app_${name}); } },`,
+		appdef: hardware.defines.OOPSY_CROSSFADE_BLOCKS 
+			? `{"${name}", []()->void { oopsy::daisy.reset(apps[oopsy::daisy.app_load_slot()].app_${name}); } },`
+			: `{"${name}", []()->void { oopsy::daisy.reset(apps.app_${name}); } },`,
 		struct: struct,
 	}
 	return app